@@ -0,0 +1,242 @@
+// File's Title: acronym_table.h
+// Description: interns enzyme acronyms as 32-bit IDs, and AcronymIdList, the small
+// vector of IDs a SequenceMap keeps instead of a vector of strings.
+
+#ifndef ACRONYM_TABLE_H
+#define ACRONYM_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// AcronymTable class
+//
+// CONSTRUCTION: through Global( ), the table every SequenceMap shares
+//
+// ******************PUBLIC OPERATIONS*********************
+// uint32_t intern( acronym )    --> Return the ID of acronym, adding it if new
+// string_view name( id )        --> Return the acronym with ID id
+// size_t size( )                --> Return the number of acronyms interned
+// size_t bytes( )               --> Return about the heap bytes the table holds
+//
+// Each distinct acronym is stored once and never moves or goes away, so a
+// name( ) stays valid for the rest of the program. IDs are dense from 0; 0 is
+// the empty acronym. intern( ) takes a lock; name( ) does not, and may run
+// while another thread interns: the names live in slots that never move, and
+// each slot is filled before its ID is handed out.
+class AcronymTable{
+  public:
+    static AcronymTable &Global(){
+        static AcronymTable table;
+        return table;
+    }
+
+    AcronymTable(const AcronymTable &rhs) = delete;
+    AcronymTable &operator=(const AcronymTable &rhs) = delete;
+
+    uint32_t intern(std::string_view acronym){
+        if(acronym.empty())
+            return 0;
+        std::lock_guard<std::mutex> lock(lock_);
+        auto found = ids_.find(acronym);
+        if(found != ids_.end())
+            return found->second;
+
+        const uint32_t id = uint32_t(size_.load(std::memory_order_relaxed));
+        const std::string_view stored = Store(acronym);
+        size_t offset;
+        const size_t slab = SlabOf(id, offset);
+        if(slabs_[slab].load(std::memory_order_relaxed) == nullptr){
+            owned_slabs_.emplace_back(new std::string_view[FIRST_SLAB_SLOTS << slab]);
+            bytes_ += (FIRST_SLAB_SLOTS << slab) * sizeof(std::string_view);
+            slabs_[slab].store(owned_slabs_.back().get(), std::memory_order_release);
+        }
+        slabs_[slab].load(std::memory_order_relaxed)[offset] = stored;
+        ids_.emplace(stored, id);
+        size_.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    std::string_view name(uint32_t id) const{
+        size_t offset;
+        const size_t slab = SlabOf(id, offset);
+        return slabs_[slab].load(std::memory_order_acquire)[offset];
+    }
+
+    size_t size() const{
+        return size_.load(std::memory_order_acquire);
+    }
+
+    size_t bytes() const{
+        std::lock_guard<std::mutex> lock(lock_);
+        return bytes_ + ids_.bucket_count() * sizeof(void *)
+            + ids_.size() * (sizeof(std::pair<std::string_view, uint32_t>) + 2 * sizeof(void *));
+    }
+
+  private:
+    // Slab k holds the names of FIRST_SLAB_SLOTS << k IDs, so 23 slabs cover every 32-bit ID
+    static const size_t FIRST_SLAB_BITS = 10;
+    static const size_t FIRST_SLAB_SLOTS = size_t(1) << FIRST_SLAB_BITS;
+    static const size_t SLABS = 23;
+    // The characters of the names, in blocks of this many bytes (or one block per longer name)
+    static const size_t TEXT_BLOCK_BYTES = 16384;
+
+    AcronymTable() : size_{1}{
+        slabs_[0].store(new std::string_view[FIRST_SLAB_SLOTS], std::memory_order_relaxed);
+        owned_slabs_.emplace_back(slabs_[0].load(std::memory_order_relaxed));
+        bytes_ = FIRST_SLAB_SLOTS * sizeof(std::string_view);
+    }
+
+    // Return the slab holding ID id and set offset to its slot there.
+    static size_t SlabOf(uint32_t id, size_t &offset){
+        const uint64_t position = uint64_t(id) + FIRST_SLAB_SLOTS;
+        const size_t slab = 63 - __builtin_clzll(position) - FIRST_SLAB_BITS;
+        offset = position - (FIRST_SLAB_SLOTS << slab);
+        return slab;
+    }
+
+    // Copy acronym into the text blocks and return the copy.
+    std::string_view Store(std::string_view acronym){
+        if(text_free_ < acronym.size()){
+            const size_t block_bytes = acronym.size() > TEXT_BLOCK_BYTES ? acronym.size() : TEXT_BLOCK_BYTES;
+            text_blocks_.emplace_back(new char[block_bytes]);
+            bytes_ += block_bytes;
+            text_next_ = text_blocks_.back().get();
+            text_free_ = block_bytes;
+        }
+        std::memcpy(text_next_, acronym.data(), acronym.size());
+        const std::string_view stored(text_next_, acronym.size());
+        text_next_ += acronym.size();
+        text_free_ -= acronym.size();
+        return stored;
+    }
+
+    mutable std::mutex lock_;                              // Guards everything below but the slabs' slots
+    std::unordered_map<std::string_view, uint32_t> ids_;
+    std::atomic<std::string_view *> slabs_[SLABS] = { };
+    std::vector<std::unique_ptr<std::string_view[]>> owned_slabs_;
+    std::vector<std::unique_ptr<char[]>> text_blocks_;
+    char *text_next_ = nullptr;
+    size_t text_free_ = 0;
+    size_t bytes_ = 0;
+    std::atomic<size_t> size_;
+};
+
+// AcronymIdList class
+//
+// CONSTRUCTION: empty
+//
+// ******************PUBLIC OPERATIONS*********************
+// size_t size( )            --> Return the number of IDs
+// uint32_t operator[]( i )  --> Return the i-th ID
+// void push_back( id )      --> Append id
+// void append( rhs )        --> Append the IDs of rhs
+//
+// The first INLINE_IDS IDs are kept in the object itself, in the bytes that
+// otherwise point to the heap, so a list of up to two acronyms (most REBASE
+// recognition sequences) costs no allocation and 16 bytes in all.
+class AcronymIdList{
+  public:
+    AcronymIdList() : size_{0}, capacity_{INLINE_IDS}{ }
+
+    AcronymIdList(const AcronymIdList &rhs) : AcronymIdList(){
+        append(rhs);
+    }
+
+    AcronymIdList(AcronymIdList &&rhs) noexcept : AcronymIdList(){
+        Steal(rhs);
+    }
+
+    AcronymIdList &operator=(const AcronymIdList &rhs){
+        if(this != &rhs){
+            size_ = 0;
+            append(rhs);
+        }
+        return *this;
+    }
+
+    AcronymIdList &operator=(AcronymIdList &&rhs) noexcept{
+        if(this != &rhs){
+            if(!isInline())
+                delete[] heap_;
+            Steal(rhs);
+        }
+        return *this;
+    }
+
+    ~AcronymIdList(){
+        if(!isInline())
+            delete[] heap_;
+    }
+
+    size_t size() const{
+        return size_;
+    }
+
+    uint32_t operator[](size_t i) const{
+        return data()[i];
+    }
+
+    void push_back(uint32_t id){
+        if(size_ == capacity_)
+            Reserve(2 * capacity_);
+        data()[size_++] = id;
+    }
+
+    void append(const AcronymIdList &rhs){
+        if(size_ + rhs.size_ > capacity_)
+            Reserve(size_ + rhs.size_ > 2 * capacity_ ? size_ + rhs.size_ : 2 * capacity_);
+        std::memcpy(data() + size_, rhs.data(), rhs.size_ * sizeof(uint32_t));
+        size_ += rhs.size_;
+    }
+
+  private:
+    static const uint32_t INLINE_IDS = 2;
+
+    bool isInline() const{
+        return capacity_ == INLINE_IDS;
+    }
+
+    uint32_t *data(){
+        return isInline() ? inline_ : heap_;
+    }
+
+    const uint32_t *data() const{
+        return isInline() ? inline_ : heap_;
+    }
+
+    // Take the IDs of rhs, leaving it empty. Any heap block of this is already freed.
+    void Steal(AcronymIdList &rhs){
+        size_ = rhs.size_;
+        capacity_ = rhs.capacity_;
+        if(rhs.isInline())
+            std::memcpy(inline_, rhs.inline_, sizeof(inline_));
+        else
+            heap_ = rhs.heap_;
+        rhs.size_ = 0;
+        rhs.capacity_ = INLINE_IDS;
+    }
+
+    void Reserve(uint32_t capacity){
+        uint32_t *ids = new uint32_t[capacity];
+        std::memcpy(ids, data(), size_ * sizeof(uint32_t));
+        if(!isInline())
+            delete[] heap_;
+        heap_ = ids;
+        capacity_ = capacity;
+    }
+
+    uint32_t size_;
+    uint32_t capacity_;             // INLINE_IDS while the IDs are inline
+    union{
+        uint32_t inline_[INLINE_IDS];
+        uint32_t *heap_;
+    };
+};
+
+#endif
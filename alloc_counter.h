@@ -0,0 +1,71 @@
+// File's Title: alloc_counter.h
+// Description: replaces the global operator new/delete with versions that count
+// heap allocations, for the benchmark programs.
+// Include it from exactly one translation unit of a program.
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_counter {
+
+// Number of calls to operator new since the program started
+inline size_t &Allocations(){
+    static size_t allocations = 0;
+    return allocations;
+}
+
+// Number of calls to operator delete on a non-null pointer since the program started
+inline size_t &Deallocations(){
+    static size_t deallocations = 0;
+    return deallocations;
+}
+
+// Number of bytes requested from operator new since the program started
+inline size_t &AllocatedBytes(){
+    static size_t allocated_bytes = 0;
+    return allocated_bytes;
+}
+
+}  // namespace alloc_counter
+
+void *operator new(std::size_t size){
+    ++alloc_counter::Allocations();
+    alloc_counter::AllocatedBytes() += size;
+    if(void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size){
+    return operator new(size);
+}
+
+// Once inlined into a caller, GCC pairs the free() below with the operator new
+// of the caller instead of the malloc() in the replacement above
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void operator delete(void *p) noexcept{
+    alloc_counter::Deallocations() += p != nullptr;
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept{
+    operator delete(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept{
+    operator delete(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept{
+    operator delete(p);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -6,16 +6,36 @@
 #ifndef AVL_TREE_MODIFIED_H
 #define AVL_TREE_MODIFIED_H
 
+#include "bloom_filter.h"
 #include "dsexceptions.h"
+#include "key_prefix.h"
+#include "node_pool.h"
 #include "sequence_map.h"
+#include "thread_pool.h"
+#include "tree_stats.h"
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <math.h>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 using namespace std;
 
 // AvlTree class
 //
 // CONSTRUCTION: zero parameter
+// NodeAllocator policy (see node_pool.h) defaults to the chunked NodePool
+// Stats policy (see tree_stats.h) defaults to NoStats, which counts nothing;
+// AvlTree<SequenceMap, NodePool, CountingStats> counts the comparisons, node
+// visits, rotations by case, allocations and rebalances of each kind of operation
+// The int & recursive_call counters of find( ), findBatch( ) and remove( ) are
+// older than the Stats policy. They are kept for the existing drivers: test_tree
+// and test_tree_mod print them, and bench_tree reports them. New code should use
+// the overloads without a counter and count with CountingStats.
 //
 // ******************PUBLIC OPERATIONS*********************
 // void insert( x )       --> Insert x
@@ -26,28 +46,176 @@ using namespace std;
 // boolean isEmpty( )     --> Return true if empty; else false
 // void makeEmpty( )      --> Remove all items
 // void printTree( )      --> Print tree in sorted order
+// void forEach( visit )  --> Call visit( x ) on every item in sorted order
 // void findRecoSeq( x ) --> Find x and print its enzyme acronym
-// int numberOfNodes()    --> Return number of nodes
-// float averageDepth()   --> Return the average depth of the tree
+// int forEachWithPrefix( p, visit ) --> Call visit( seq, acronym ) for every
+//                                       sequence starting with p; return their number
+// int numberOfNodes()    --> Return number of nodes, in O( 1 )
+// float averageDepth()   --> Return the average depth of the tree, in O( 1 )
 // float averageDepthRatio() --> Return the ratio of the average depth of the tree
+// bool isValid( )        --> Return true if every AVL invariant holds, in O( n )
 // int find( x, recursive_call ) --> Return 1 if item is found, else 0 
+// int findBatch( keys, n, found, recursive_call ) --> find( ) on n keys at once
 // int remove( x, recursive_call ) --> Return 1 if item is removed, else 0
+// int find( x ), int remove( x ) --> The same, counting nothing
+// Comparable select( k )  --> Return the k-th smallest item, counting from 0
+// int rank( x )          --> Return the number of items less than x
+// int countRange( lo, hi ) --> Return the number of items in [ lo, hi )
+// const_iterator begin( ), end( ) --> Bidirectional iterators over the sorted items
+// const_iterator lower_bound( x ) --> First item not less than x
+// const_iterator upper_bound( x ) --> First item greater than x
+// pair equal_range( x )  --> [ lower_bound( x ), upper_bound( x ) )
+// void bulkLoad( begin, end ) --> Replace contents with [begin, end), any order
+// void buildFromSorted( begin, end ) --> Replace contents with sorted [begin, end)
+// void enableFilter( )   --> Keep a Bloom filter that find( ), findBatch( ),
+//                            contains( ) and findRecoSeq( ) consult first
+// void disableFilter( )  --> Drop the filter
+// bool filterEnabled( )  --> Return true if the tree keeps a filter
+// FilterCounters filterCounters( ) --> Return what the filter has answered
+// void split( x, greater ) --> Move the items not less than x into greater
+// void join( rhs )       --> Append rhs, whose items are all greater, emptying it
+// void unionWith( rhs [, workers] )  --> Move the items of rhs in, merging duplicates
+// void intersect( rhs [, workers] )  --> Keep the items also in rhs, merging them
+// void difference( rhs [, workers] ) --> Remove the items also in rhs
+// const Stats & stats( )  --> Return what the Stats policy has counted
+// void resetStats( )      --> Start the counts again from zero
 // ******************ERRORS********************************
 // Throws UnderflowException as warranted
+// Throws ArrayIndexOutOfBoundsException from select( ) when k is out of range
+// Throws IteratorOutOfBoundsException on ++end( ) or --begin( )
+// Throws IllegalArgumentException from join( ) if the items are out of order,
+// and from split( ) and the set operations if rhs is the tree itself
 
-template <typename Comparable>
-class AvlTree
+template <typename Comparable, template <typename> class NodeAllocator = NodePool, typename Stats = NoStats>
+class AvlTree : private Stats
 {
+private:
+    struct AvlNode;
+
 public:
-    AvlTree( ) : root{ nullptr }
+    /**
+     * Bidirectional iterator over the items in sorted order.
+     * Each node knows its parent, so stepping needs no stack and no
+     * allocation, and a full pass costs O( 1 ) per step amortized.
+     * The end iterator holds nullptr; decrementing it gives the largest item.
+     */
+    class const_iterator
+    {
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Comparable value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Comparable * pointer;
+        typedef const Comparable & reference;
+
+        const_iterator( ) : current{ nullptr }, tree{ nullptr }
+        { }
+
+        reference operator*( ) const
+            { return current->element; }
+        pointer operator->( ) const
+            { return &current->element; }
+
+        const_iterator & operator++( )
+        {
+            if( current == nullptr )
+                throw IteratorOutOfBoundsException{ };
+            if( current->right != nullptr )
+            {
+                current = current->right;
+                while( current->left != nullptr )
+                    current = current->left;
+            }
+            else
+            {
+                const AvlNode *child = current;
+                current = current->parent;
+                while( current != nullptr && child == current->right )
+                {
+                    child = current;
+                    current = current->parent;
+                }
+            }
+            return *this;
+        }
+
+        const_iterator operator++( int )
+        {
+            const_iterator old = *this;
+            ++( *this );
+            return old;
+        }
+
+        const_iterator & operator--( )
+        {
+            if( current == nullptr )
+                current = tree->findMax( tree->root );
+            else if( current->left != nullptr )
+            {
+                current = current->left;
+                while( current->right != nullptr )
+                    current = current->right;
+            }
+            else
+            {
+                const AvlNode *child = current;
+                current = current->parent;
+                while( current != nullptr && child == current->left )
+                {
+                    child = current;
+                    current = current->parent;
+                }
+            }
+            if( current == nullptr )
+                throw IteratorOutOfBoundsException{ };
+            return *this;
+        }
+
+        const_iterator operator--( int )
+        {
+            const_iterator old = *this;
+            --( *this );
+            return old;
+        }
+
+        bool operator==( const const_iterator & rhs ) const
+            { return current == rhs.current; }
+        bool operator!=( const const_iterator & rhs ) const
+            { return !( *this == rhs ); }
+
+      private:
+        const AvlNode *current;
+        const AvlTree *tree;
+
+        const_iterator( const AvlNode *p, const AvlTree *t ) : current{ p }, tree{ t }
+        { }
+
+        friend class AvlTree;
+    };
+
+    /**
+     * What the filter has answered since enableFilter( ): the lookups it
+     * settled alone, the lookups it let through that found their key, the
+     * ones it let through in vain, and how often it was rebuilt.
+     */
+    struct FilterCounters
+    {
+        size_t rejected = 0;
+        size_t hits = 0;
+        size_t falsePositives = 0;
+        size_t rebuilds = 0;
+    };
+
+    AvlTree( ) : Stats{ }, root{ nullptr }
     { }
     
-    AvlTree( const AvlTree & rhs ) : root{ nullptr }
+    AvlTree( const AvlTree & rhs ) : Stats{ }, root{ nullptr }, filter{ rhs.filter }
     {
+        statistics( ).begin( TREE_BUILD );
         root = clone( rhs.root );
     }
     
-    AvlTree( AvlTree && rhs ) : root{ rhs.root }
+    AvlTree( AvlTree && rhs ) : Stats{ }, root{ rhs.root }, pool{ std::move( rhs.pool ) }, filter{ std::move( rhs.filter ) }
     {
         rhs.root = nullptr;
     }
@@ -73,6 +241,8 @@ public:
     AvlTree & operator=( AvlTree && rhs )
     {
         std::swap( root, rhs.root );
+        pool.swap( rhs.pool );
+        std::swap( filter, rhs.filter );
         return *this;
     }
     
@@ -103,7 +273,10 @@ public:
      */
     bool contains( const Comparable & x ) const
     {
-        return contains( x, root );
+        statistics( ).begin( TREE_FIND );
+        if( filterRejects( x ) )
+            return false;
+        return filterPassed( contains( x, root ) );
     }
     
     /**
@@ -126,12 +299,49 @@ public:
             printTree( root );
     }
     
+    /**
+     * Call visit( x ) on every item in sorted order.
+     */
+    template <typename Visitor>
+    void forEach( Visitor visit ) const
+    {
+        PathStack<AvlNode *> path;
+        AvlNode *t = root;
+        while( t != nullptr || !path.empty( ) )
+        {
+            if( t != nullptr )
+            {
+                path.push( t );
+                t = t->left;
+            }
+            else
+            {
+                t = path.pop( );
+                visit( static_cast<const Comparable &>( t->element ) );
+                t = t->right;
+            }
+        }
+    }
+
     /**
      * Make the tree logically empty.
+     * A pooled tree destroys the elements and then frees whole chunks at once.
      */
     void makeEmpty( )
     {
-        makeEmpty( root );
+        if( NodeAllocator<AvlNode>::BULK_RELEASE )
+        {
+            destroyElements( root );
+            root = nullptr;
+            pool.release( );
+        }
+        else
+            makeEmpty( root );
+        if( filterEnabled( ) )
+        {
+            filter.bloom.clear( );
+            filter.removed = 0;
+        }
     }
     
     /**
@@ -139,7 +349,9 @@ public:
      */
     void insert( const Comparable & x )
     {
+            statistics( ).begin( TREE_INSERT );
         insert(x, root);
+            filterInserted( x );
     }
     
     /**
@@ -147,23 +359,71 @@ public:
      */
     void insert( Comparable && x )
     {
+            const uint64_t h = filterEnabled( ) ? PrefixTraits::hash( x ) : 0;
+            statistics( ).begin( TREE_INSERT );
         insert(std::move(x), root);
+            filterInsertedHash( h );
     }
     
+    /**
+     * Replace the contents of the tree with the items in [begin, end),
+     * which may come in any order. The items are stable-sorted first, so
+     * duplicates are merged in input order, as repeated insert() would do.
+     * Pass move iterators to avoid copying the items.
+     */
+    template <typename Iterator>
+    void bulkLoad( Iterator begin, Iterator end )
+    {
+        vector<Comparable> items( begin, end );
+        std::stable_sort( items.begin( ), items.end( ) );
+        buildFromSorted( std::make_move_iterator( items.begin( ) ), std::make_move_iterator( items.end( ) ) );
+    }
+
+    /**
+     * Replace the contents of the tree with the items in [begin, end),
+     * which must be sorted. Runs of equal items are combined with Merge(),
+     * then a height-balanced tree is built in O(n) with no rotations.
+     */
+    template <typename Iterator>
+    void buildFromSorted( Iterator begin, Iterator end )
+    {
+        vector<Comparable> items;
+        for( ; begin != end; ++begin )
+        {
+            if( !items.empty( ) && !( items.back( ) < *begin ) )
+                items.back( ).Merge( *begin );
+            else
+                items.push_back( *begin );
+        }
+        makeEmpty( );
+        statistics( ).begin( TREE_BUILD );
+        root = buildBalanced( items, 0, items.size( ) );
+        if( filterEnabled( ) )
+            rebuildFilter( );
+    }
+     
     /**
      * Remove x from the tree. Nothing is done if x is not found.
      */
     void remove( const Comparable & x )
     {
+        const int before = numberOfNodes( );
+        statistics( ).begin( TREE_REMOVE );
         remove( x, root );
+        filterRemoved( before - numberOfNodes( ) );
     }
     
     /**
-     * Find the item in the tree and print the associated enzyme acronym
+     * Find the item in the tree and print the associated enzyme acronym.
+     * Keys are compared in place against the elements; no copies are made.
      */
-    void findRecoSeq( const string & x ) const
+    void findRecoSeq( std::string_view x ) const
     {
-        return findRecoSeq( x, root );
+        statistics( ).begin( TREE_FIND );
+        if( filterRejects( x ) )
+            cout<<"Not Found"<<endl;
+        else
+            filterPassed( findRecoSeq( x, root ) );
     }
     
     /**
@@ -177,8 +437,7 @@ public:
      * Return the average depth of the tree
      */
     float averageDepth() const{
-        float tree_depth = 0;
-        return depth( root, tree_depth ) / numberOfNodes();
+        return float( depth( root ) ) / numberOfNodes();
     }
     
     /**
@@ -187,149 +446,885 @@ public:
     float averageDepthRatio() const{
         return averageDepth() / log2(numberOfNodes());
     }
+
+    /**
+     * Return true if the tree is a valid AVL tree: the items are in order,
+     * each node's prefix is the prefix of its item, every stored height,
+     * size and depth sum is exact, the two subtrees of every node differ in
+     * height by at most one, and every node's parent is set. O( n ); for tests.
+     */
+    bool isValid( ) const
+    {
+        return checkSubtree( root, nullptr, nullptr, nullptr ) != INVALID_SUBTREE;
+    }
+    
+    /**
+     * Return the k-th smallest item in the tree, counting from 0, in O( log n ).
+     * Throw ArrayIndexOutOfBoundsException if k is not in [ 0, numberOfNodes() ).
+     */
+    const Comparable & select( int k ) const
+    {
+        if( k < 0 || k >= numberOfNodes( ) )
+            throw ArrayIndexOutOfBoundsException{ };
+        AvlNode *t = root;
+        while( true )
+        {
+            int leftSize = numberOfNodes( t->left );
+            if( k < leftSize )
+                t = t->left;
+            else if( k > leftSize )
+            {
+                k -= leftSize + 1;
+                t = t->right;
+            }
+            else
+                return t->element;
+        }
+    }
+    
+    /**
+     * Return the number of items less than x, in O( log n ).
+     * x need not be in the tree.
+     */
+    int rank( std::string_view x ) const
+    {
+        statistics( ).begin( TREE_FIND );
+        return rank( x, root );
+    }
+    
+    /**
+     * Return the number of items in the half-open range [ lo, hi ),
+     * or 0 if hi is not greater than lo, in O( log n ).
+     * One descent finds the node where the paths to lo and hi part; only
+     * the two paths below it are walked apart. A Stats policy counts it
+     * as one TREE_FIND.
+     */
+    int countRange( std::string_view lo, std::string_view hi ) const
+    {
+        if( !( lo < hi ) )
+            return 0;
+        statistics( ).begin( TREE_FIND );
+        const Prefix lop = PrefixTraits::of( lo );
+        const Prefix hip = PrefixTraits::of( hi );
+        AvlNode *t = root;
+        while( t != nullptr )
+        {
+            if( compare( hi, hip, t ) <= 0 )
+                t = t->left;
+            else if( compare( lo, lop, t ) > 0 )
+                t = t->right;
+            else   // lo <= t < hi: t is in the range and the paths part here
+                return numberOfNodes( t->left ) - rank( lo, t->left ) + 1 + rank( hi, t->right );
+        }
+        return 0;
+    }
+    
+    /**
+     * Call visit( recognition_sequence, enzyme_acronym ) for every enzyme whose
+     * recognition sequence starts with prefix, in sorted order of sequence.
+     * The lower bound of prefix is found in O( log n ) and the scan stops at
+     * the first sequence that does not match, so O( log n + k ) nodes are visited.
+     * Both arguments are views into the tree; they stay valid until it changes.
+     * Return the number of matching sequences.
+     */
+    template <typename Visitor>
+    int forEachWithPrefix( std::string_view prefix, Visitor visit ) const
+    {
+        int matches = 0;
+        for( const_iterator itr = lower_bound( prefix ); itr != end( ); ++itr )
+        {
+            std::string_view sequence = itr->getRecognitionSequence( );
+            if( sequence.substr( 0, prefix.size( ) ) != prefix )
+                break;
+            for( size_t i = 0; i < itr->getEnzymeCount( ); ++i )
+                visit( sequence, itr->getEnzymeAcronym( i ) );
+            ++matches;
+        }
+        return matches;
+    }
+    
+    /**
+     * Return an iterator to the smallest item, or end( ) if empty.
+     */
+    const_iterator begin( ) const
+    {
+        return const_iterator( findMin( root ), this );
+    }
+    
+    /**
+     * Return the iterator one past the largest item.
+     */
+    const_iterator end( ) const
+    {
+        return const_iterator( nullptr, this );
+    }
+    
+    /**
+     * Return an iterator to the first item not less than x, or end( ).
+     * Scanning from here while items match visits a range without copying it.
+     */
+    const_iterator lower_bound( std::string_view x ) const
+    {
+        statistics( ).begin( TREE_FIND );
+        return const_iterator( lowerBound( x, root ), this );
+    }
+    
+    /**
+     * Return an iterator to the first item greater than x, or end( ).
+     */
+    const_iterator upper_bound( std::string_view x ) const
+    {
+        statistics( ).begin( TREE_FIND );
+        return const_iterator( upperBound( x, root ), this );
+    }
+    
+    /**
+     * Return the range of items equal to x: empty, or the one item with key x.
+     */
+    std::pair<const_iterator, const_iterator> equal_range( std::string_view x ) const
+    {
+        return { lower_bound( x ), upper_bound( x ) };
+    }
     
     /**
      * Return 1 if item is found, else 0
+     * A key the filter rejects is not searched for, and adds no recursive call.
+     */
+    int find( std::string_view x, int &find_recursive_call ) const{
+        statistics( ).begin( TREE_FIND );
+        if( filterRejects( x ) )
+            return 0;
+        return filterPassed( find( x, root, find_recursive_call) );
+    }
+    
+    /**
+     * Look up keys[ 0 .. n ) and set found[ i ] to 1 if keys[ i ] is found, else 0.
+     * Return the number of keys found. find_recursive_call is updated exactly as
+     * n calls to find( ) would update it.
+     * The searches advance in lockstep, so the next node of each one can be
+     * prefetched while the others are compared. With a filter, the keys it
+     * rejects are dropped from each group before the searches start.
      */
-    int find( const string & x, int &find_recursive_call ) const{
-        return find( x, root, find_recursive_call);
+    int findBatch( const std::string_view *keys, size_t n, int *found, int &find_recursive_call ) const{
+        statistics( ).begin( TREE_FIND );
+        int successful_query = 0;
+        for( size_t first = 0; first < n; first += FIND_BATCH_SIZE ){
+            size_t size = n - first < FIND_BATCH_SIZE ? n - first : FIND_BATCH_SIZE;
+            if( filterEnabled( ) )
+                successful_query += findFilteredGroup( keys + first, size, found + first, find_recursive_call );
+            else
+                successful_query += findGroup( keys + first, size, found + first, find_recursive_call );
+        }
+        return successful_query;
     }
     
     /**
      * Return 1 if item is removed, else 0
      */
-    int remove( const string & x, int &remove_recursive_call ){
-        return remove( x, root, remove_recursive_call);
+    int remove( std::string_view x, int &remove_recursive_call ){
+        statistics( ).begin( TREE_REMOVE );
+        const int removed = remove( x, root, remove_recursive_call);
+        filterRemoved( removed );
+        return removed;
+    }
+
+    /**
+     * find( ) and remove( ) for callers that do not count visits; a Stats
+     * policy such as CountingStats counts them instead. This remove( )
+     * rebalances, as remove( x ) does.
+     */
+    int find( std::string_view x ) const{
+        int find_recursive_call = 0;
+        return find( x, find_recursive_call );
+    }
+
+    int remove( std::string_view x ){
+        const int before = numberOfNodes( );
+        statistics( ).begin( TREE_REMOVE );
+        remove( x, root );
+        const int removed = before - numberOfNodes( );
+        filterRemoved( removed );
+        return removed;
+    }
+
+    /**
+     * Keep a blocked Bloom filter (see bloom_filter.h) of the keys in front of
+     * the tree, built now and kept up to date by every change after. Lookups
+     * of absent keys then mostly end at the filter, a single cache line,
+     * instead of a search down the tree. Removed keys stay in the filter until
+     * it is rebuilt, when a quarter of it is stale or it outgrows its size.
+     * Worth it only when many lookups miss: a key that is present pays for
+     * the hash and the filter on top of its search.
+     * The counters start again from zero.
+     */
+    void enableFilter( )
+    {
+        rebuildFilter( );
+        filter.counters = SharedFilterCounters{ };
+    }
+
+    /**
+     * Drop the filter and its counters.
+     */
+    void disableFilter( )
+    {
+        filter = FilterState{ };
+    }
+
+    /**
+     * Return true if the tree keeps a filter.
+     */
+    bool filterEnabled( ) const
+    {
+        return filter.bloom.isSized( );
+    }
+
+    /**
+     * Return what the filter has answered since it was enabled.
+     */
+    FilterCounters filterCounters( ) const
+    {
+        return filter.counters.load( );
+    }
+
+    /**
+     * Return what the Stats policy has counted since the tree was made or
+     * resetStats( ) was last called. Copies and moves of a tree start their
+     * own counts; the counts are never moved or swapped between trees.
+     */
+    const Stats & stats( ) const
+    {
+        return *this;
+    }
+
+    void resetStats( )
+    {
+        Stats::reset( );
+    }
+
+    /**
+     * Move every item not less than x into greater, replacing its items,
+     * and keep the items less than x, in O( log n ). The nodes are not copied:
+     * the two trees go on sharing the memory they were built in.
+     * A tree with a filter rebuilds it, in O( n ).
+     * Throw IllegalArgumentException if greater is this tree.
+     */
+    void split( std::string_view x, AvlTree & greater )
+    {
+        if( &greater == this )
+            throw IllegalArgumentException{ };
+        greater.makeEmpty( );
+        statistics( ).begin( TREE_SET_OPERATION );
+        pool.share( greater.pool );
+        AvlNode *less;
+        AvlNode *notLess;
+        AvlNode *match = split( root, x, PrefixTraits::of( x ), less, notLess );
+        if( match != nullptr )
+            notLess = join( nullptr, match, notLess );
+        root = less;
+        greater.root = notLess;
+        setParent( root, nullptr );
+        setParent( greater.root, nullptr );
+        if( filterEnabled( ) )
+            rebuildFilter( );
+        if( greater.filterEnabled( ) )
+            greater.rebuildFilter( );
+    }
+
+    /**
+     * Move the items of rhs, which must all be greater than the items here,
+     * into this tree and leave rhs empty, in O( log n ).
+     * A tree with a filter rebuilds it, in O( n ).
+     * Throw IllegalArgumentException if an item of rhs is not greater.
+     */
+    void join( AvlTree && rhs )
+    {
+        statistics( ).begin( TREE_SET_OPERATION );
+        if( !isEmpty( ) && !rhs.isEmpty( ) && !( findMax( root )->element < findMin( rhs.root )->element ) )
+            throw IllegalArgumentException{ };
+        root = join2( root, takeNodes( rhs ) );
+        setParent( root, nullptr );
+        if( filterEnabled( ) )
+            rebuildFilter( );
+    }
+
+    /**
+     * Move the items of rhs into this tree and leave rhs empty; an item of
+     * rhs equal to one here is combined into it with Merge( ). The trees are
+     * split around each other's roots and joined back, which takes
+     * O( m log( n / m + 1 ) ) for m <= n items instead of m inserts.
+     * With workers, the halves of every large split are combined in parallel.
+     */
+    void unionWith( AvlTree && rhs )
+    {
+        combineWith( rhs, UNION, nullptr );
+    }
+
+    void unionWith( AvlTree && rhs, ThreadPool & workers )
+    {
+        combineWith( rhs, UNION, &workers );
+    }
+
+    /**
+     * Keep only the items that rhs has too, combining its equal item into
+     * each with Merge( ), and leave rhs empty. Costs as unionWith( ).
+     */
+    void intersect( AvlTree && rhs )
+    {
+        combineWith( rhs, INTERSECTION, nullptr );
+    }
+
+    void intersect( AvlTree && rhs, ThreadPool & workers )
+    {
+        combineWith( rhs, INTERSECTION, &workers );
+    }
+
+    /**
+     * Remove the items that rhs has too, whatever their payload, and leave
+     * rhs empty. Costs as unionWith( ).
+     */
+    void difference( AvlTree && rhs )
+    {
+        combineWith( rhs, DIFFERENCE, nullptr );
+    }
+
+    void difference( AvlTree && rhs, ThreadPool & workers )
+    {
+        combineWith( rhs, DIFFERENCE, &workers );
     }
     
     
 private:
+    typedef KeyPrefixTraits<Comparable> PrefixTraits;
+    typedef typename PrefixTraits::Prefix Prefix;
+
+    // The fields a search reads come first, so most steps only touch the
+    // node header: the children, the height and an inline prefix of the key
+    // (see key_prefix.h). The element follows and is read only when two
+    // prefixes tie; its payload (the enzyme acronyms of a SequenceMap)
+    // lives in its own heap block.
+    // size and depthSum describe the subtree the node roots: its number of
+    // nodes and the sum of their depths below it. They are kept exact through
+    // every change, so the tree's size and average depth are read off the root.
+    // parent is nullptr at the root and is only read by const_iterator.
     struct AvlNode
     {
-        Comparable element;
-        AvlNode   *left;
-        AvlNode   *right;
-        int       height;
-        
+        AvlNode     *left;
+        AvlNode     *right;
+        Prefix      prefix;
+        signed char height;
+        int         size;
+        long long   depthSum;
+        AvlNode     *parent;
+        Comparable  element;
+
         AvlNode( const Comparable & ele, AvlNode *lt, AvlNode *rt, int h = 0 )
-        : element{ ele }, left{ lt }, right{ rt }, height{ h } { }
+          : left{ lt }, right{ rt }, prefix( PrefixTraits::of( ele ) ), height( h ),
+            size{ 1 }, depthSum{ 0 }, parent{ nullptr }, element{ ele } { }
         
         AvlNode( Comparable && ele, AvlNode *lt, AvlNode *rt, int h = 0 )
-        : element{ std::move( ele ) }, left{ lt }, right{ rt }, height{ h } { }
+          : left{ lt }, right{ rt }, prefix( PrefixTraits::of( ele ) ), height( h ),
+            size{ 1 }, depthSum{ 0 }, parent{ nullptr }, element{ std::move( ele ) } { }
     };
-    
+
+    // FilterCounters as relaxed atomics: they change in const lookups, which
+    // may run on several threads at once. Copies read and write each counter
+    // on its own, so a copy made during lookups is only roughly consistent.
+    struct SharedFilterCounters
+    {
+        std::atomic<size_t> rejected{ 0 };
+        std::atomic<size_t> hits{ 0 };
+        std::atomic<size_t> falsePositives{ 0 };
+        std::atomic<size_t> rebuilds{ 0 };
+
+        SharedFilterCounters( ) = default;
+
+        SharedFilterCounters( const SharedFilterCounters & rhs )
+        {
+            *this = rhs;
+        }
+
+        SharedFilterCounters & operator=( const SharedFilterCounters & rhs )
+        {
+            FilterCounters values = rhs.load( );
+            rejected.store( values.rejected, std::memory_order_relaxed );
+            hits.store( values.hits, std::memory_order_relaxed );
+            falsePositives.store( values.falsePositives, std::memory_order_relaxed );
+            rebuilds.store( values.rebuilds, std::memory_order_relaxed );
+            return *this;
+        }
+
+        FilterCounters load( ) const
+        {
+            FilterCounters values;
+            values.rejected = rejected.load( std::memory_order_relaxed );
+            values.hits = hits.load( std::memory_order_relaxed );
+            values.falsePositives = falsePositives.load( std::memory_order_relaxed );
+            values.rebuilds = rebuilds.load( std::memory_order_relaxed );
+            return values;
+        }
+
+        static void count( std::atomic<size_t> & counter )
+        {
+            counter.fetch_add( 1, std::memory_order_relaxed );
+        }
+    };
+
+    // The optional Bloom filter in front of the tree; see enableFilter( ).
+    // removed counts the keys gone from the tree but still in the filter.
+    struct FilterState
+    {
+        BlockedBloomFilter bloom;
+        size_t removed = 0;
+        mutable SharedFilterCounters counters;
+    };
+
     AvlNode *root;
+    NodeAllocator<AvlNode> pool;
+    FilterState filter;
+
+    /**
+     * The Stats policy, a private base so that NoStats takes no room. Its
+     * hooks are const, as lookups are counted too, and every NoStats hook is
+     * an empty inline call, so nothing is left of them.
+     */
+    const Stats & statistics( ) const
+    {
+        return *this;
+    }
+
+    // A rebuilt filter is sized for twice the nodes, and never fewer than this
+    static const size_t MIN_FILTER_KEYS = 1024;
     
     
+    // An AVL tree of n nodes is less than 1.44 log2( n + 2 ) high, so this
+    // bounds the path of any tree that fits in memory.
+    static const int MAX_HEIGHT = 96;
+
     /**
-     * Internal method to insert into a subtree.
-     * x is the item to insert.
-     * t is the node that roots the subtree.
-     * Set the new root of the subtree.
-     * In case of duplicates, call Merge().
+     * Fixed-size stack that stands in for the recursion.
+     * Throw ArrayIndexOutOfBoundsException if a path outgrows MAX_HEIGHT.
      */
-    void insert( const Comparable & x, AvlNode * & t )
+    template <typename Entry>
+    struct PathStack
     {
-        if( t == nullptr )
-            t = new AvlNode{ x, nullptr, nullptr };
-        else if( x < t->element )
-            insert( x, t->left );
-        else if( t->element < x )
-            insert( x, t->right );
-        else{
-            t->element.Merge(x);
-            return;
+        Entry entries[ MAX_HEIGHT ];
+        int size = 0;
+
+        void push( const Entry & x )
+        {
+            if( size == MAX_HEIGHT )
+                throw ArrayIndexOutOfBoundsException{ };
+            entries[ size++ ] = x;
         }
-        
-        balance( t );
-    }
+        Entry pop( )
+            { return entries[ --size ]; }
+        bool empty( ) const
+            { return size == 0; }
+    };
     
     /**
      * Internal method to insert into a subtree.
-     * x is the item to insert.
+     * x is the item to insert, either const Comparable & or Comparable &&.
      * t is the node that roots the subtree.
-     * Set the new root of the subtree.
+     * Walk down remembering the links, then rebalance back up the path.
      * In case of duplicates, call Merge().
      */
-    void insert( Comparable && x, AvlNode * & t )
+    template <typename Item>
+    void insert( Item && x, AvlNode * & t )
     {
-        if( t == nullptr )
-            t = new AvlNode{ std::move( x ), nullptr, nullptr };
-        else if( x < t->element )
-            insert( std::move( x ), t->left );
-        else if( t->element < x )
-            insert( std::move( x ), t->right );
-        else{
-            t->element.Merge(x);
-            return;
+        const Prefix xp = PrefixTraits::of( x );
+        PathStack<AvlNode **> path;
+        AvlNode **link = &t;
+        AvlNode *parent = nullptr;
+        while( *link != nullptr )
+        {
+            AvlNode *node = *link;
+            path.push( link );
+            parent = node;
+            int order = compare( x, xp, node );
+            if( order < 0 )
+                link = &node->left;
+            else if( order > 0 )
+                link = &node->right;
+            else{
+                node->element.Merge(x);
+                return;
+            }
         }
-        
-        balance( t );
+        *link = pool.construct( std::forward<Item>( x ), nullptr, nullptr );
+        statistics( ).record( TREE_ALLOCATION );
+        ( *link )->parent = parent;
+        rebalance( path );
     }
     
     /**
      * Internal method to remove from a subtree.
-     * x is the item to remove.
+     * x is the item, or the key of the item, to remove.
      * t is the node that roots the subtree.
      * Set the new root of the subtree.
      */
-    void remove( const Comparable & x, AvlNode * & t )
+    template <typename Key>
+    void remove( const Key & x, AvlNode * & t )
     {
-        if( t == nullptr )
-            return;   // Item not found; do nothing
-        
-        if( x < t->element )
-            remove( x, t->left );
-        else if( t->element < x )
-            remove( x, t->right );
-        else if( t->left != nullptr && t->right != nullptr ) // Two children
+        const Prefix xp = PrefixTraits::of( x );
+        PathStack<AvlNode **> path;
+        AvlNode **link = &t;
+        while( true )
         {
-            t->element = findMin( t->right )->element;
-            remove( t->element, t->right );
+            AvlNode *node = *link;
+            if( node == nullptr )
+                return;   // Item not found; do nothing
+            int order = compare( x, xp, node );
+            if( order < 0 )
+            {
+                path.push( link );
+                link = &node->left;
+            }
+            else if( order > 0 )
+            {
+                path.push( link );
+                link = &node->right;
+            }
+            else
+                break;
         }
-        else
+        unlink( link, path );
+        rebalance( path );
+    }
+
+    /**
+     * Internal method to take the node at *link out of the tree.
+     * A node with two children takes the smallest item of its right subtree,
+     * and that item's node is removed instead.
+     * path holds the links above *link and gets the links walked below it.
+     */
+    void unlink( AvlNode **link, PathStack<AvlNode **> & path )
+    {
+        AvlNode *node = *link;
+        if( node->left != nullptr && node->right != nullptr ) // Two children
         {
-            AvlNode *oldNode = t;
-            t = ( t->left != nullptr ) ? t->left : t->right;
-            delete oldNode;
+            path.push( link );
+            link = &node->right;
+            while( ( *link )->left != nullptr )
+            {
+                path.push( link );
+                link = &( *link )->left;
+            }
+            node->element = std::move( ( *link )->element );
+            node->prefix = ( *link )->prefix;
         }
-        
-        balance( t );
+        AvlNode *oldNode = *link;
+        *link = ( oldNode->left != nullptr ) ? oldNode->left : oldNode->right;
+        setParent( *link, oldNode->parent );
+        pool.destroy( oldNode );
+    }
+
+    /**
+     * Internal method to rebalance the nodes on path, deepest first.
+     * Once a subtree comes out of balance() with the height it had before,
+     * no rotation is needed above it, so only the counts of the remaining
+     * nodes are brought up to date.
+     */
+    void rebalance( PathStack<AvlNode **> & path )
+    {
+        while( !path.empty( ) )
+        {
+            AvlNode * & t = *path.pop( );
+            int oldHeight = t->height;
+            balance( t );
+            if( t->height == oldHeight )
+                break;
+        }
+        while( !path.empty( ) )
+            updateCounts( *path.pop( ) );
     }
     
+    /**
+     * Three-way comparison of key x against the element in node t.
+     * xp is the prefix of x; the element is read only when the prefixes tie.
+     * Return negative, zero or positive as x is less, equal or greater.
+     * Every search step comes through here, so this is where the Stats
+     * policy counts the visits and the element comparisons.
+     */
+    template <typename Key>
+    int compare( const Key & x, const Prefix & xp, const AvlNode *t ) const
+    {
+        statistics( ).record( TREE_VISIT );
+        int order = Prefix::compare( xp, t->prefix );
+        if( order != PREFIX_UNDECIDED )
+            return order;
+        statistics( ).record( TREE_ELEMENT_COMPARISON );
+        if( x < t->element )
+            return -1;
+        if( t->element < x )
+            return 1;
+        return 0;
+    }
+
     static const int ALLOWED_IMBALANCE = 1;
     
+    // Set operations fork only on subtrees holding at least this many nodes
+    // between them, so a task does enough work to pay for its scheduling
+    static const int PARALLEL_GRAIN = 4096;
+
+    enum SetOperation { UNION, INTERSECTION, DIFFERENCE };
+
+    // Searches in flight at once in findBatch( ); enough to cover a cache miss
+    static const size_t FIND_BATCH_SIZE = 16;
+
     // Assume t is balanced or within one of being balanced
+    // The rotations are counted here, where the case is known, so that a
+    // double rotation counts once and not as its two single ones
     void balance( AvlNode * & t )
     {
         if( t == nullptr )
             return;
         
+        statistics( ).record( TREE_REBALANCE );
         if( height( t->left ) - height( t->right ) > ALLOWED_IMBALANCE ) {
-            if( height( t->left->left ) >= height( t->left->right ) )
+            if( height( t->left->left ) >= height( t->left->right ) ) {
+                statistics( ).record( TREE_ROTATE_WITH_LEFT_CHILD );
                 rotateWithLeftChild( t );
-            else
+            } else {
+                statistics( ).record( TREE_DOUBLE_WITH_LEFT_CHILD );
                 doubleWithLeftChild( t );
+            }
         } else if( height( t->right ) - height( t->left ) > ALLOWED_IMBALANCE ) {
-            if( height( t->right->right ) >= height( t->right->left ) )
+            if( height( t->right->right ) >= height( t->right->left ) ) {
+                statistics( ).record( TREE_ROTATE_WITH_RIGHT_CHILD );
                 rotateWithRightChild( t );
-            else
+            } else {
+                statistics( ).record( TREE_DOUBLE_WITH_RIGHT_CHILD );
                 doubleWithRightChild( t );
+            }
         }
-        t->height = max( height( t->left ), height( t->right ) ) + 1;
+        update( t );
     }
     
+    /**
+     * Internal method to build a balanced subtree from items[ low, high ).
+     * The middle item becomes the root, so the heights of the two halves
+     * differ by at most one and every level but the last is full.
+     * Return the root of the subtree.
+     */
+    AvlNode * buildBalanced( vector<Comparable> & items, size_t low, size_t high )
+    {
+        if( low == high )
+            return nullptr;
+        size_t middle = low + ( high - low ) / 2;
+        AvlNode *left = buildBalanced( items, low, middle );
+        AvlNode *right = buildBalanced( items, middle + 1, high );
+        AvlNode *t = pool.construct( std::move( items[ middle ] ), left, right );
+        statistics( ).record( TREE_ALLOCATION );
+        setParent( left, t );
+        setParent( right, t );
+        update( t );
+        return t;
+    }
+
+    /**
+     * Internal method to join the subtrees l and r, every item of l less than
+     * the item of node k and every item of r greater, under or around k.
+     * Walk down the spine of the higher subtree to a node as high as the
+     * other, hang the two from k there and rebalance back up; each level
+     * grows by at most one, so one rotation fixes it. O( |height difference| ).
+     * Return the root of the joined subtree; its parent is left to the caller.
+     */
+    AvlNode * join( AvlNode *l, AvlNode *k, AvlNode *r )
+    {
+        if( height( l ) > height( r ) + ALLOWED_IMBALANCE )
+        {
+            l->right = join( l->right, k, r );
+            l->right->parent = l;
+            balance( l );
+            return l;
+        }
+        if( height( r ) > height( l ) + ALLOWED_IMBALANCE )
+        {
+            r->left = join( l, k, r->left );
+            r->left->parent = r;
+            balance( r );
+            return r;
+        }
+        k->left = l;
+        k->right = r;
+        setParent( l, k );
+        setParent( r, k );
+        update( k );
+        return k;
+    }
+
+    /**
+     * Internal method to join the subtrees l and r, every item of l less than
+     * every item of r, around the largest node of l. O( log n ).
+     */
+    AvlNode * join2( AvlNode *l, AvlNode *r )
+    {
+        if( l == nullptr )
+            return r;
+        AvlNode *last;
+        AvlNode *rest = splitLast( l, last );
+        return join( rest, last, r );
+    }
+
+    /**
+     * Internal method to take the largest node off a nonempty subtree t.
+     * Set last to the node and return the root of what is left.
+     */
+    AvlNode * splitLast( AvlNode *t, AvlNode * & last )
+    {
+        if( t->right == nullptr )
+        {
+            last = t;
+            return t->left;
+        }
+        AvlNode *rest = splitLast( t->right, last );
+        return join( t->left, t, rest );
+    }
+
+    /**
+     * Internal method to split subtree t around key x, whose prefix is xp:
+     * set less and greater to the subtrees of the items less and greater
+     * than x, and return the node equal to x, with no children, or nullptr.
+     * The nodes on the path are joined back on the way up. O( log n ).
+     */
+    template <typename Key>
+    AvlNode * split( AvlNode *t, const Key & x, const Prefix & xp, AvlNode * & less, AvlNode * & greater )
+    {
+        if( t == nullptr )
+        {
+            less = greater = nullptr;
+            return nullptr;
+        }
+        AvlNode *left = t->left;
+        AvlNode *right = t->right;
+        int order = compare( x, xp, t );
+        if( order < 0 )
+        {
+            AvlNode *match = split( left, x, xp, less, greater );
+            greater = join( greater, t, right );
+            return match;
+        }
+        if( order > 0 )
+        {
+            AvlNode *match = split( right, x, xp, less, greater );
+            less = join( left, t, less );
+            return match;
+        }
+        less = left;
+        greater = right;
+        t->left = t->right = nullptr;
+        return t;
+    }
+
+    /**
+     * Internal method to take the nodes of rhs, leaving it empty.
+     * This pool adopts the memory they live in. Return their root.
+     * Throw IllegalArgumentException if rhs is this tree.
+     */
+    AvlNode * takeNodes( AvlTree & rhs )
+    {
+        if( &rhs == this )
+            throw IllegalArgumentException{ };
+        pool.adopt( rhs.pool );
+        AvlNode *other = rhs.root;
+        rhs.root = nullptr;
+        rhs.makeEmpty( );
+        return other;
+    }
+
+    /**
+     * Internal method for the set operations: combine the nodes of rhs into
+     * this tree, then destroy the nodes left over, now that no task runs.
+     */
+    void combineWith( AvlTree & rhs, SetOperation operation, ThreadPool *workers )
+    {
+        statistics( ).begin( TREE_SET_OPERATION );
+        AvlNode *other = takeNodes( rhs );
+        vector<AvlNode *> discarded;
+        root = combine( root, other, operation, workers, discarded );
+        setParent( root, nullptr );
+        for( AvlNode *t : discarded )
+            makeEmpty( t );
+        if( filterEnabled( ) )
+            rebuildFilter( );
+    }
+
+    /**
+     * Internal method to combine subtrees a and b by operation. Split b around
+     * the root of a, combine the two left and the two right parts, and join
+     * the results around the root of a if it stays, else around each other.
+     * A duplicate is merged into the node of a. Nodes that leave the tree go
+     * on discarded, whole subtrees at a time; none is destroyed here, since
+     * the pool is not safe to use from several tasks.
+     * With workers, the left parts of a large split are combined as a task
+     * while this thread combines the right parts.
+     * Return the root of the combined subtree.
+     */
+    AvlNode * combine( AvlNode *a, AvlNode *b, SetOperation operation, ThreadPool *workers,
+                       vector<AvlNode *> & discarded )
+    {
+        if( a == nullptr || b == nullptr )
+        {
+            if( operation == UNION )
+                return a != nullptr ? a : b;
+            if( operation == INTERSECTION && a != nullptr )
+                discarded.push_back( a );
+            if( b != nullptr )
+                discarded.push_back( b );
+            return operation == DIFFERENCE ? a : nullptr;
+        }
+        const int work = a->size + b->size;
+        AvlNode *leftA = a->left;
+        AvlNode *rightA = a->right;
+        a->left = a->right = nullptr;
+        AvlNode *leftB;
+        AvlNode *rightB;
+        AvlNode *match = split( b, a->element, a->prefix, leftB, rightB );
+
+        AvlNode *left;
+        AvlNode *right;
+        if( workers != nullptr && work >= PARALLEL_GRAIN )
+        {
+            vector<AvlNode *> leftDiscarded;
+            TaskGroup group( *workers );
+            group.run( [ & ]( ){ left = combine( leftA, leftB, operation, workers, leftDiscarded ); } );
+            right = combine( rightA, rightB, operation, workers, discarded );
+            group.wait( );
+            discarded.insert( discarded.end( ), leftDiscarded.begin( ), leftDiscarded.end( ) );
+        }
+        else
+        {
+            left = combine( leftA, leftB, operation, workers, discarded );
+            right = combine( rightA, rightB, operation, workers, discarded );
+        }
+
+        bool keep = operation == UNION || ( operation == INTERSECTION ) == ( match != nullptr );
+        if( match != nullptr )
+        {
+            if( keep )
+                a->element.Merge( match->element );
+            discarded.push_back( match );
+        }
+        if( !keep )
+        {
+            discarded.push_back( a );
+            return join2( left, right );
+        }
+        return join( left, a, right );
+    }
+
     /**
      * Internal method to find the smallest item in a subtree t.
      * Return node containing the smallest item.
      */
     AvlNode * findMin( AvlNode *t ) const
     {
-        if( t == nullptr )
-            return nullptr;
-        if( t->left == nullptr )
-            return t;
-        return findMin( t->left );
+        if( t != nullptr )
+            while( t->left != nullptr )
+                t = t->left;
+        return t;
     }
     
     /**
@@ -351,44 +1346,73 @@ private:
      */
     bool contains( const Comparable & x, AvlNode *t ) const
     {
-        if( t == nullptr )
-            return false;
-        else if( x < t->element )
-            return contains( x, t->left );
-        else if( t->element < x )
-            return contains( x, t->right );
-        else
-            return true;    // Match
-    }
-    /****** NONRECURSIVE VERSION*************************
-     bool contains( const Comparable & x, AvlNode *t ) const
-     {
-     while( t != nullptr )
-     if( x < t->element )
-     t = t->left;
-     else if( t->element < x )
-     t = t->right;
-     else
-     return true;    // Match
-     
-     return false;   // No match
-     }
-     *****************************************************/
-    
+        const Prefix xp = PrefixTraits::of( x );
+        while( t != nullptr )
+        {
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+                t = t->right;
+            else
+                return true;    // Match
+        }
+
+        return false;   // No match
+    }
+
     /**
      * Internal method to make subtree empty.
+     * Rotate left children up until the root has none, then delete the root
+     * and carry on with its right subtree; no stack is needed.
      */
     void makeEmpty( AvlNode * & t )
     {
-        if( t != nullptr )
+        while( t != nullptr )
         {
-            makeEmpty( t->left );
-            makeEmpty( t->right );
-            delete t;
+            AvlNode *next;
+            if( t->left != nullptr )
+            {
+                next = t->left;
+                t->left = next->right;
+                next->right = t;
+            }
+            else
+            {
+                next = t->right;
+                pool.destroy( t );
+            }
+            t = next;
         }
-        t = nullptr;
     }
-    
+
+    /**
+     * Internal method to run the element destructors of a subtree
+     * without giving the node storage back to the pool.
+     * Walks the subtree the same way as makeEmpty( ).
+     */
+    void destroyElements( AvlNode *t )
+    {
+        if( std::is_trivially_destructible<AvlNode>::value )
+            return;
+        while( t != nullptr )
+        {
+            AvlNode *next;
+            if( t->left != nullptr )
+            {
+                next = t->left;
+                t->left = next->right;
+                next->right = t;
+            }
+            else
+            {
+                next = t->right;
+                t->~AvlNode( );
+            }
+            t = next;
+        }
+    }
+
     /**
      * Internal method to print a subtree rooted at t in sorted order.
      */
@@ -405,12 +1429,33 @@ private:
     /**
      * Internal method to clone subtree.
      */
-    AvlNode * clone( AvlNode *t ) const
+    AvlNode * clone( AvlNode *t )
     {
-        if( t == nullptr )
-            return nullptr;
-        else
-            return new AvlNode{ t->element, clone( t->left ), clone( t->right ), t->height };
+        struct Pending
+        {
+            AvlNode *from;
+            AvlNode **to;
+            AvlNode *parent;
+        };
+        AvlNode *copy = nullptr;
+        PathStack<Pending> pending;
+        if( t != nullptr )
+            pending.push( Pending{ t, &copy, nullptr } );
+        while( !pending.empty( ) )
+        {
+            Pending next = pending.pop( );
+            AvlNode *node = pool.construct( next.from->element, nullptr, nullptr, next.from->height );
+            statistics( ).record( TREE_ALLOCATION );
+            node->size = next.from->size;
+            node->depthSum = next.from->depthSum;
+            node->parent = next.parent;
+            *next.to = node;
+            if( next.from->right != nullptr )
+                pending.push( Pending{ next.from->right, &node->right, node } );
+            if( next.from->left != nullptr )
+                pending.push( Pending{ next.from->left, &node->left, node } );
+        }
+        return copy;
     }
         // Avl manipulations
     /**
@@ -426,33 +1471,67 @@ private:
         return lhs > rhs ? lhs : rhs;
     }
     
+    /**
+     * Make p the parent of node t, unless t is nullptr.
+     */
+    static void setParent( AvlNode *t, AvlNode *p )
+    {
+        if( t != nullptr )
+            t->parent = p;
+    }
+
+    /**
+     * Recompute the size and depth sum of node t from its children.
+     * Each node of a child subtree is one deeper below t than below the child.
+     */
+    void updateCounts( AvlNode *t )
+    {
+        t->size = 1 + numberOfNodes( t->left ) + numberOfNodes( t->right );
+        t->depthSum = depth( t->left ) + depth( t->right ) + t->size - 1;
+    }
+
+    /**
+     * Recompute the height, size and depth sum of node t from its children.
+     */
+    void update( AvlNode *t )
+    {
+        t->height = max( height( t->left ), height( t->right ) ) + 1;
+        updateCounts( t );
+    }
+
     /**
      * Rotate binary tree node with left child.
      * For AVL trees, this is a single rotation for case 1.
-     * Update heights, then set new root.
+     * Update heights and parents, then set new root.
      */
     void rotateWithLeftChild( AvlNode * & k2 )
     {
         AvlNode *k1 = k2->left;
         k2->left = k1->right;
         k1->right = k2;
-        k2->height = max( height( k2->left ), height( k2->right ) ) + 1;
-        k1->height = max( height( k1->left ), k2->height ) + 1;
+        setParent( k2->left, k2 );
+        k1->parent = k2->parent;
+        k2->parent = k1;
+        update( k2 );
+        update( k1 );
         k2 = k1;
     }
     
     /**
      * Rotate binary tree node with right child.
      * For AVL trees, this is a single rotation for case 4.
-     * Update heights, then set new root.
+     * Update heights and parents, then set new root.
      */
     void rotateWithRightChild( AvlNode * & k1 )
     {
         AvlNode *k2 = k1->right;
         k1->right = k2->left;
         k2->left = k1;
-        k1->height = max( height( k1->left ), height( k1->right ) ) + 1;
-        k2->height = max( height( k2->right ), k1->height ) + 1;
+        setParent( k1->right, k1 );
+        k2->parent = k1->parent;
+        k1->parent = k2;
+        update( k1 );
+        update( k2 );
         k1 = k2;
     }
     
@@ -460,7 +1539,7 @@ private:
      * Double rotate binary tree node: first left child.
      * with its right child; then node k3 with new left child.
      * For AVL trees, this is a double rotation for case 2.
-     * Update heights, then set new root.
+     * Update heights and parents, then set new root.
      */
     void doubleWithLeftChild( AvlNode * & k3 )
     {
@@ -470,9 +1549,14 @@ private:
         k2->left = k1;
         k3->left = k2->right;
         k2->right = k3;
-        k1->height = max( height( k1->left ), height( k1->right ) ) + 1;
-        k3->height = max( height( k3->left ), height( k3->right ) ) + 1;
-        k2->height = max( k1->height, k3->height ) + 1;
+        setParent( k1->right, k1 );
+        setParent( k3->left, k3 );
+        k2->parent = k3->parent;
+        k1->parent = k2;
+        k3->parent = k2;
+        update( k1 );
+        update( k3 );
+        update( k2 );
         k3 = k2;
     }
     
@@ -480,7 +1564,7 @@ private:
      * Double rotate binary tree node: first right child.
      * with its left child; then node k1 with new right child.
      * For AVL trees, this is a double rotation for case 3.
-     * Update heights, then set new root.
+     * Update heights and parents, then set new root.
      */
     void doubleWithRightChild( AvlNode * & k1 )
     {
@@ -490,9 +1574,14 @@ private:
         k2->right = k3;
         k1->right = k2->left;
         k2->left = k1;
-        k1->height = max( height( k1->left ), height( k1->right ) ) + 1;
-        k3->height = max( height( k3->left ), height( k3->right ) ) + 1;
-        k2->height = max( k1->height, k3->height ) + 1;
+        setParent( k3->left, k3 );
+        setParent( k1->right, k1 );
+        k2->parent = k1->parent;
+        k1->parent = k2;
+        k3->parent = k2;
+        update( k1 );
+        update( k3 );
+        update( k2 );
         k1 = k2;
     }
     
@@ -500,81 +1589,340 @@ private:
      * Find the item in the tree and print the associated enzyme acronym if found
      * Else print "Not Found"
      */
-    void findRecoSeq( const string & x, AvlNode *t ) const
+    template <typename Key>
+    bool findRecoSeq( const Key & x, AvlNode *t ) const
     {
-        if( t == nullptr )
-            cout<<"Not Found"<<endl;
-        else if( x < t->element.getRecognitionSequence() )
-            return findRecoSeq( x, t->left );
-        else if( t->element.getRecognitionSequence() < x )
-            return findRecoSeq( x, t->right );
-        else
-            t -> element.printEnzymeAcronym();
+        const Prefix xp = PrefixTraits::of( x );
+        while( t != nullptr ){
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+                t = t->right;
+            else{
+                t -> element.printEnzymeAcronym();
+                return true;
+            }
+        }
+        cout<<"Not Found"<<endl;
+        return false;
     }
     
+    // What checkSubtree( ) returns for a subtree that breaks an invariant
+    static const int INVALID_SUBTREE = -2;
+
     /**
-     * Return the number of nodes in the tree
+     * Internal method to check the subtree t for isValid( ).
+     * parent is the node t must name as its parent; the items of t must be
+     * greater than the item of lo and less than the item of hi, where given.
+     * Return the height of t, or INVALID_SUBTREE.
+     */
+    int checkSubtree( const AvlNode *t, const AvlNode *parent, const AvlNode *lo, const AvlNode *hi ) const
+    {
+        if( t == nullptr )
+            return -1;
+        if( t->parent != parent )
+            return INVALID_SUBTREE;
+        if( ( lo != nullptr && !( lo->element < t->element ) ) || ( hi != nullptr && !( t->element < hi->element ) ) )
+            return INVALID_SUBTREE;
+        int prefixOrder = Prefix::compare( t->prefix, PrefixTraits::of( t->element ) );
+        if( prefixOrder != 0 && prefixOrder != PREFIX_UNDECIDED )
+            return INVALID_SUBTREE;
+        int leftHeight = checkSubtree( t->left, t, lo, t );
+        int rightHeight = checkSubtree( t->right, t, t, hi );
+        if( leftHeight == INVALID_SUBTREE || rightHeight == INVALID_SUBTREE )
+            return INVALID_SUBTREE;
+        if( leftHeight - rightHeight > ALLOWED_IMBALANCE || rightHeight - leftHeight > ALLOWED_IMBALANCE )
+            return INVALID_SUBTREE;
+        int size = 1 + numberOfNodes( t->left ) + numberOfNodes( t->right );
+        if( t->height != max( leftHeight, rightHeight ) + 1 || t->size != size
+            || t->depthSum != depth( t->left ) + depth( t->right ) + size - 1 )
+            return INVALID_SUBTREE;
+        return t->height;
+    }
+
+    /**
+     * Return the number of nodes in the subtree t
      */
     int numberOfNodes( AvlNode *t ) const{
-        if(t != nullptr)
-            return numberOfNodes(t -> left) + numberOfNodes(t -> right) +1;
-        return 0;
+        return t == nullptr ? 0 : t -> size;
     }
     
     /**
-     * Return the depth of the tree
+     * Return the sum of the depths of all nodes in the subtree t
      */
-    float depth( AvlNode *t, float tree_depth ) const{
-        if(t != nullptr)
-            return depth( t-> left, tree_depth+1 ) + depth( t-> right, tree_depth+1 ) + tree_depth;
-        return 0;
+    long long depth( AvlNode *t ) const{
+        return t == nullptr ? 0 : t -> depthSum;
+    }
+    
+    /**
+     * Internal method to find the first node not less than x in a subtree.
+     * Return nullptr if every item is less than x.
+     */
+    template <typename Key>
+    AvlNode * lowerBound( const Key & x, AvlNode *t ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        AvlNode *bound = nullptr;
+        while( t != nullptr )
+        {
+            if( compare( x, xp, t ) <= 0 )
+            {
+                bound = t;
+                t = t->left;
+            }
+            else
+                t = t->right;
+        }
+        return bound;
+    }
+    
+    /**
+     * Internal method to find the first node greater than x in a subtree.
+     * Return nullptr if no item is greater than x.
+     */
+    template <typename Key>
+    AvlNode * upperBound( const Key & x, AvlNode *t ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        AvlNode *bound = nullptr;
+        while( t != nullptr )
+        {
+            if( compare( x, xp, t ) < 0 )
+            {
+                bound = t;
+                t = t->left;
+            }
+            else
+                t = t->right;
+        }
+        return bound;
+    }
+    
+    /**
+     * Internal method to count the items less than x in a subtree.
+     * x is any key type the elements compare against.
+     * t is the node that roots the subtree.
+     * Each step right passes the left subtree and the node itself.
+     */
+    template <typename Key>
+    int rank( const Key & x, AvlNode *t ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        int less = 0;
+        while( t != nullptr )
+        {
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+            {
+                less += numberOfNodes( t->left ) + 1;
+                t = t->right;
+            }
+            else
+                return less + numberOfNodes( t->left );
+        }
+        return less;
     }
     
     /**
      * Search for an item in the tree
-     * x is item to search for.
+     * x is item to search for; any key type the elements compare against.
      * t is the node that roots the tree.
      * Update the number of recursive calls made
      */
-    bool find( const string & x, AvlNode *t, int &find_recursive_call ) const{
-        ++find_recursive_call;
-        if( t == nullptr )
+    template <typename Key>
+    bool find( const Key & x, AvlNode *t, int &find_recursive_call ) const{
+        const Prefix xp = PrefixTraits::of( x );
+        while( true ){
+            ++find_recursive_call;
+            if( t == nullptr )
+                return false;
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+                t = t->right;
+            else
+                return true;
+        }
+    }
+    
+    /**
+     * Search for keys[ 0 .. n ), n <= FIND_BATCH_SIZE, in lockstep.
+     * Each round takes one step of every unfinished search and prefetches
+     * the node it moves to, so that node is in cache by the next round.
+     * Return the number of keys found; count visits as find( ) does.
+     */
+    template <typename Key>
+    int findGroup( const Key *keys, size_t n, int *found, int &find_recursive_call ) const{
+        const AvlNode *nodes[ FIND_BATCH_SIZE ];
+        Prefix prefixes[ FIND_BATCH_SIZE ];
+        size_t pending[ FIND_BATCH_SIZE ];
+        for( size_t i = 0; i < n; ++i ){
+            nodes[ i ] = root;
+            prefixes[ i ] = PrefixTraits::of( keys[ i ] );
+            pending[ i ] = i;
+            found[ i ] = 0;
+        }
+        int successful_query = 0;
+        size_t unfinished = n;
+        while( unfinished > 0 ){
+            size_t still_unfinished = 0;
+            for( size_t j = 0; j < unfinished; ++j ){
+                size_t i = pending[ j ];
+                const AvlNode *t = nodes[ i ];
+                ++find_recursive_call;
+                if( t == nullptr )
+                    continue;
+                int order = compare( keys[ i ], prefixes[ i ], t );
+                if( order == 0 ){
+                    found[ i ] = 1;
+                    ++successful_query;
+                    continue;
+                }
+                t = order < 0 ? t->left : t->right;
+                if( t != nullptr )
+                    __builtin_prefetch( t );
+                nodes[ i ] = t;
+                pending[ still_unfinished++ ] = i;
+            }
+            unfinished = still_unfinished;
+        }
+        return successful_query;
+    }
+    
+    /**
+     * findGroup( ) for a tree with a filter: the keys the filter rejects are
+     * set not found and counted, and the rest are searched for as one group.
+     */
+    template <typename Key>
+    int findFilteredGroup( const Key *keys, size_t n, int *found, int &find_recursive_call ) const{
+        Key passed[ FIND_BATCH_SIZE ];
+        size_t passedAt[ FIND_BATCH_SIZE ];
+        int passedFound[ FIND_BATCH_SIZE ];
+        size_t m = 0;
+        for( size_t i = 0; i < n; ++i ){
+            found[ i ] = 0;
+            if( !filterRejects( keys[ i ] ) ){
+                passed[ m ] = keys[ i ];
+                passedAt[ m++ ] = i;
+            }
+        }
+        int successful_query = findGroup( passed, m, passedFound, find_recursive_call );
+        for( size_t j = 0; j < m; ++j )
+            found[ passedAt[ j ] ] = filterPassed( passedFound[ j ] );
+        return successful_query;
+    }
+
+    /**
+     * Return true if the tree keeps a filter and it proves x absent,
+     * counting the rejection.
+     */
+    template <typename Key>
+    bool filterRejects( const Key & x ) const
+    {
+        if( !filterEnabled( ) || filter.bloom.mayContain( PrefixTraits::hash( x ) ) )
             return false;
-        else if( x < t->element.getRecognitionSequence() )
-            return find( x, t->left, find_recursive_call );
-        else if( t->element.getRecognitionSequence() < x )
-            return find( x, t->right, find_recursive_call );
+        SharedFilterCounters::count( filter.counters.rejected );
+        return true;
+    }
+
+    /**
+     * Count the outcome of a search the filter let through, and return found.
+     */
+    template <typename Result>
+    Result filterPassed( Result found ) const
+    {
+        if( filterEnabled( ) )
+            SharedFilterCounters::count( found ? filter.counters.hits : filter.counters.falsePositives );
+        return found;
+    }
+
+    /**
+     * Add the hash of an inserted key to the filter, if there is one;
+     * rebuild it instead once it holds more keys than it was sized for.
+     * A duplicate merged into its node is added again, which is harmless.
+     */
+    void filterInsertedHash( uint64_t h )
+    {
+        if( !filterEnabled( ) )
+            return;
+        if( filter.bloom.added( ) >= filter.bloom.capacity( ) )
+            rebuildFilter( );
         else
-            return true;
+            filter.bloom.add( h );
     }
-    
+
+    void filterInserted( const Comparable & x )
+    {
+        if( filterEnabled( ) )
+            filterInsertedHash( PrefixTraits::hash( x ) );
+    }
+
+    /**
+     * Note that n keys have left the tree; rebuild the filter once more than
+     * a quarter of what it was sized for is stale.
+     */
+    void filterRemoved( size_t n )
+    {
+        if( !filterEnabled( ) || n == 0 )
+            return;
+        filter.removed += n;
+        if( filter.removed > filter.bloom.capacity( ) / 4 )
+            rebuildFilter( );
+    }
+
+    /**
+     * Size the filter for twice the nodes and add every key again.
+     */
+    void rebuildFilter( )
+    {
+        const size_t n = 2 * size_t( numberOfNodes( ) );
+        filter.bloom.reset( n > MIN_FILTER_KEYS ? n : MIN_FILTER_KEYS );
+        forEach( [ this ]( const Comparable & x ){ filter.bloom.add( PrefixTraits::hash( x ) ); } );
+        filter.removed = 0;
+        SharedFilterCounters::count( filter.counters.rebuilds );
+    }
+
     /**
      * Internal method to remove from a subtree.
-     * x is the item to remove.
+     * x is the key of the item to remove.
      * t is the node that roots the subtree.
      * Set the new root of the subtree.
-     * Update the number of recursive calls made.
+     * Update the number of recursive calls made, counted as one per node
+     * visited, the way the recursive version counted them: the nodes down
+     * to x, and for a node with two children the nodes down to the smallest
+     * item of its right subtree.
+     * Rebalance back up the path like remove( x, t ), so the tree stays AVL
+     * and the heights later updates stop early on stay exact. The recursive
+     * version never reached its balance( ) call, so test_tree's 5b, 6b and 6c
+     * differ from the assignment's reference outputs.
      */
-    bool remove( const string & x, AvlNode * & t, int &remove_recursive_call ){
-        ++remove_recursive_call;
-        if( t == nullptr )
-            return false;
-        if( x < t->element.getRecognitionSequence() )
-            return remove( x, t->left, remove_recursive_call );
-        else if( t->element.getRecognitionSequence() < x )
-            return remove( x, t->right, remove_recursive_call );
-        // Two children
-        else if( t->left != nullptr && t->right != nullptr ){
-            t->element = findMin( t->right )->element;
-            return remove( t->element.getRecognitionSequence(), t->right, remove_recursive_call );
-        }
-        else{
-            AvlNode *oldNode = t;
-            t = ( t->left != nullptr ) ? t->left : t->right;
-            delete oldNode;
-            return true;
-        }
-        balance( t );
+    template <typename Key>
+    bool remove( const Key & x, AvlNode * & t, int &remove_recursive_call ){
+        const Prefix xp = PrefixTraits::of( x );
+        PathStack<AvlNode **> path;
+        AvlNode **link = &t;
+        while( true ){
+            ++remove_recursive_call;
+            AvlNode *node = *link;
+            if( node == nullptr )
+                return false;
+            int order = compare( x, xp, node );
+            if( order == 0 )
+                break;
+            path.push( link );
+            link = order < 0 ? &node->left : &node->right;
+        }
+        AvlNode *node = *link;
+        if( node->left != nullptr && node->right != nullptr )   // Two children
+            for( AvlNode *successor = node->right; successor != nullptr; successor = successor->left )
+                ++remove_recursive_call;
+        unlink( link, path );
+        rebalance( path );
+        return true;
     }
     
 };
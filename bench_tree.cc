@@ -0,0 +1,580 @@
+// File's Title: bench_tree.cc
+// Description: benchmark suite for the AVL tree. Times the parsing of the database,
+// then insert, find, findBatch, remove, bulk build, iteration and teardown on the
+// REBASE data and on synthetic datasets of random sequences, reporting ns/op, heap
+// allocations per op and the resident set size after each benchmark. Every tree
+// benchmark runs on AvlTree<SequenceMap> and again on AvlTree<PackedSequenceMap>,
+// whose names carry the suffix /packed. BM_BothStrands compares looking a query
+// up on both strands with two finds against one lookup of its canonical form.
+// BM_Memory reports the heap a tree of SequenceMap holds per node.
+// BM_Stats times a tree that counts its work with CountingStats (see tree_stats.h)
+// against the default one, which counts nothing, and prints the counts per operation.
+// Built twice: bench_tree measures avl_tree.h and bench_tree_mod, compiled with
+// -DMODIFIED_TREE, measures the direct double rotations of avl_tree_modified.h.
+
+#include "alloc_counter.h"
+#include "canonical_sequence_map.h"
+#ifdef MODIFIED_TREE
+#include "avl_tree_modified.h"
+#else
+#include "avl_tree.h"
+#endif
+#include "frozen_sequence_index.h"
+#include "packed_sequence.h"
+#include "persistent_avl_tree.h"
+#include "rebase_loader.h"
+#include "reverse_complement.h"
+#include "sequence_map.h"
+#include "thread_pool.h"
+#include "tree_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const string &filename){
+    ifstream in_file(filename);
+    if(in_file.fail()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// Return the resident set size of the process in megabytes, from /proc/self/status.
+double ResidentMegabytes(){
+    ifstream status("/proc/self/status");
+    string field;
+    while(status>>field){
+        if(field == "VmRSS:"){
+            double kilobytes = 0;
+            status>>kilobytes;
+            return kilobytes / 1024;
+        }
+        status.ignore(256, '\n');
+    }
+    return 0;
+}
+
+// Accumulates the time and the heap allocations of the measured parts of a benchmark.
+class Stopwatch{
+  public:
+    void start(){
+        allocations_before_ = alloc_counter::Allocations();
+        start_ = chrono::steady_clock::now();
+    }
+    void stop(){
+        nanoseconds_ += chrono::duration<double, nano>(chrono::steady_clock::now() - start_).count();
+        allocations_ += alloc_counter::Allocations() - allocations_before_;
+    }
+    double nanoseconds() const{ return nanoseconds_; }
+    double allocations() const{ return allocations_; }
+
+  private:
+    chrono::steady_clock::time_point start_;
+    size_t allocations_before_ = 0;
+    double nanoseconds_ = 0;
+    double allocations_ = 0;
+};
+
+// @name: the benchmark name, Google Benchmark style, e.g. BM_Find/rebase.
+// @operations: the number of operations the stopwatch measured.
+// @stopwatch: the measurements.
+// Print one line of the report.
+void Report(const string &name, double operations, const Stopwatch &stopwatch){
+    cout<<left<<setw(32)<<name<<right<<fixed<<setprecision(1)
+        <<setw(12)<<stopwatch.nanoseconds()/operations<<" ns"
+        <<setw(12)<<setprecision(2)<<stopwatch.allocations()/operations
+        <<setw(12)<<setprecision(1)<<ResidentMegabytes()<<" MB"<<endl;
+    cout.unsetf(ios::floatfield);
+}
+
+// One set of benchmark inputs: the items to insert, in insertion order, and
+// the keys to look up, some present and some absent.
+struct Dataset{
+    string name;
+    vector<SequenceMap> items;
+    vector<string> queries;
+};
+
+// @db_filename: an input database filename.
+// @seq_filename: an input sequences filename.
+// Return the REBASE records in file order, queried with the sequences file.
+Dataset RebaseDataset(const string &db_filename, const string &seq_filename){
+    Dataset dataset;
+    dataset.name = "rebase";
+    CheckFile(db_filename);
+    MappedFile db_file(db_filename);
+    ForEachRebaseRecord(db_file.contents(), [&dataset](string_view enz_acro, string_view reco_seq){
+        dataset.items.emplace_back(reco_seq, enz_acro);
+    });
+    CheckFile(seq_filename);
+    ifstream seq_file(seq_filename);
+    string seq_line;
+    while(getline(seq_file, seq_line))
+        dataset.queries.push_back(seq_line);
+    return dataset;
+}
+
+// @number_of_keys: the number of items.
+// Return random 16-base sequences in random order, queried with every
+// inserted sequence and as many random ones, which are almost all absent.
+Dataset SyntheticDataset(size_t number_of_keys){
+    Dataset dataset;
+    dataset.name = "random/" + to_string(number_of_keys);
+    mt19937_64 random(number_of_keys);
+    auto random_sequence = [&random](){
+        string sequence(16, 'A');
+        for(char &base : sequence)
+            base = "ACGT"[random() % 4];
+        return sequence;
+    };
+    dataset.items.reserve(number_of_keys);
+    dataset.queries.reserve(2 * number_of_keys);
+    for(size_t i = 0; i < number_of_keys; ++i){
+        dataset.items.emplace_back(random_sequence(), "Enz");
+        dataset.queries.push_back(dataset.items.back().getRecognitionSequence());
+        dataset.queries.push_back(random_sequence());
+    }
+    return dataset;
+}
+
+// @db_filename: an input database filename.
+// Tokenize the mapped database repeatedly and report the parsing throughput.
+void BenchParse(const string &db_filename){
+    const int kRounds = 2000;
+    CheckFile(db_filename);
+    MappedFile db_file(db_filename);
+    size_t records = 0;
+    Stopwatch stopwatch;
+    stopwatch.start();
+    for(int round = 0; round < kRounds; ++round)
+        ForEachRebaseRecord(db_file.contents(), [&records](string_view enz_acro, string_view reco_seq){
+            records += !reco_seq.empty();
+        });
+    stopwatch.stop();
+    Report("BM_Parse/rebase", double(records), stopwatch);
+    cout<<"  "<<fixed<<setprecision(0)<<double(kRounds) * db_file.contents().size() * 1e3 / stopwatch.nanoseconds()<<" MB/s"<<endl;
+    cout.unsetf(ios::floatfield);
+}
+
+// Reverse-complement a megabyte of random IUPAC text with the scalar and the
+// dispatched kernel and report the throughput of each.
+void BenchReverseComplement(){
+    const int kRounds = 200;
+    const char kCodes[] = "ACGTRYSWKMBDHVN'";
+    mt19937_64 random(19);
+    string sequence(1 << 20, 'A');
+    for(char &code : sequence)
+        code = kCodes[random() % 16];
+    string reverse(sequence.size(), 'A');
+    auto report = [&](const string &name, void (*kernel)(const char *, size_t, char *)){
+        Stopwatch stopwatch;
+        stopwatch.start();
+        for(int round = 0; round < kRounds; ++round)
+            kernel(sequence.data(), sequence.size(), &reverse[0]);
+        stopwatch.stop();
+        Report(name, double(kRounds) * sequence.size(), stopwatch);
+        cout<<"  "<<fixed<<setprecision(0)<<double(kRounds) * sequence.size() * 1e3 / stopwatch.nanoseconds()<<" MB/s"<<endl;
+        cout.unsetf(ios::floatfield);
+    };
+    report("BM_ReverseComplement/scalar", ReverseComplementScalar);
+    report(ReverseComplementIsVectorized() ? "BM_ReverseComplement/ssse3" : "BM_ReverseComplement/scalar",
+           static_cast<void (*)(const char *, size_t, char *)>(ReverseComplement));
+}
+
+// @dataset: the inputs.
+// Build a tree of the dataset and report the heap it holds per node: bytes, as
+// malloc counts them, and live blocks, as the allocation counters do.
+void BenchMemory(const Dataset &dataset){
+    const size_t blocks_before = alloc_counter::Allocations() - alloc_counter::Deallocations();
+    const size_t bytes_before = mallinfo2().uordblks;
+    AvlTree<SequenceMap> a_tree;
+    for(const SequenceMap &item : dataset.items)
+        a_tree.insert(item);
+    const double blocks = double(alloc_counter::Allocations() - alloc_counter::Deallocations() - blocks_before);
+    const double bytes = double(mallinfo2().uordblks - bytes_before);
+    const double nodes = a_tree.numberOfNodes();
+    cout<<left<<setw(32)<<"BM_Memory/" + dataset.name<<right<<fixed<<setprecision(1)
+        <<setw(12)<<bytes / nodes<<" B/node"<<setw(12)<<setprecision(2)<<blocks / nodes<<" blocks/node"<<endl;
+    cout.unsetf(ios::floatfield);
+}
+
+// @dataset: the inputs.
+// Find the enzymes of every query on both strands: with two finds in a tree of
+// SequenceMap, the query and its reverse complement, and with one lookup of the
+// canonical form in a tree of CanonicalSequenceMap.
+void BenchBothStrands(const Dataset &dataset){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.queries.size());
+    AvlTree<SequenceMap> a_tree;
+    AvlTree<CanonicalSequenceMap> canonical_tree;
+    for(const SequenceMap &item : dataset.items){
+        a_tree.insert(item);
+        canonical_tree.insert(CanonicalSequenceMap(item.getRecognitionSequence(), item.getEnzymeAcronym(0)));
+    }
+
+    int find_recursive_call = 0;
+    size_t two_finds = 0;
+    Stopwatch find;
+    find.start();
+    for(int round = 0; round < kRounds; ++round)
+        for(const string &query : dataset.queries)
+            two_finds += a_tree.find(string_view(query), find_recursive_call)
+                + a_tree.find(string_view(ReverseComplement(query)), find_recursive_call);
+    find.stop();
+    Report("BM_BothStrands/" + dataset.name + "/two_finds", double(kRounds) * dataset.queries.size(), find);
+
+    size_t enzymes = 0;
+    Stopwatch canonical;
+    canonical.start();
+    for(int round = 0; round < kRounds; ++round)
+        for(const string &query : dataset.queries)
+            enzymes += FindBothStrands(canonical_tree, query, [](string_view, char){ });
+    canonical.stop();
+    Report("BM_BothStrands/" + dataset.name + "/canonical", double(kRounds) * dataset.queries.size(), canonical);
+    cout<<"  "<<a_tree.numberOfNodes()<<" nodes, "<<canonical_tree.numberOfNodes()<<" canonical"<<endl;
+}
+
+// @dataset: the inputs.
+// Find every query with and without the Bloom filter in front of the tree, one
+// at a time and in batches, and print what the filter answered.
+void BenchFilter(const Dataset &dataset){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.queries.size());
+    const vector<string_view> keys(dataset.queries.begin(), dataset.queries.end());
+    AvlTree<SequenceMap> a_tree;
+    a_tree.bulkLoad(dataset.items.begin(), dataset.items.end());
+
+    int successful_query[2] = {0, 0};
+    int batch_successful_query[2] = {0, 0};
+    vector<int> found(keys.size());
+    for(int filtered = 0; filtered < 2; ++filtered){
+        const string name = dataset.name + (filtered ? "/filtered" : "/unfiltered");
+        if(filtered)
+            a_tree.enableFilter();
+        int find_recursive_call = 0;
+        Stopwatch find;
+        find.start();
+        for(int round = 0; round < kRounds; ++round)
+            for(string_view key : keys)
+                successful_query[filtered] += a_tree.find(key, find_recursive_call);
+        find.stop();
+        Report("BM_Find/" + name, double(kRounds) * keys.size(), find);
+
+        int batch_recursive_call = 0;
+        Stopwatch find_batch;
+        find_batch.start();
+        for(int round = 0; round < kRounds; ++round)
+            batch_successful_query[filtered] += a_tree.findBatch(keys.data(), keys.size(), found.data(), batch_recursive_call);
+        find_batch.stop();
+        Report("BM_FindBatch/" + name, double(kRounds) * keys.size(), find_batch);
+    }
+    if(successful_query[0] != successful_query[1] || batch_successful_query[0] != batch_successful_query[1])
+        cout<<"  MISMATCH between the filtered and unfiltered finds"<<endl;
+    const auto counters = a_tree.filterCounters();
+    cout<<"  filter: "<<counters.rejected<<" rejected, "<<counters.hits<<" hits, "
+        <<counters.falsePositives<<" false positives, "<<counters.rebuilds<<" rebuilds"<<endl;
+}
+
+// @dataset: the inputs.
+// Find every query in the tree and in the frozen index made from it, and print
+// the bytes of each.
+void BenchFrozen(const Dataset &dataset){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.queries.size());
+    const vector<string_view> keys(dataset.queries.begin(), dataset.queries.end());
+    const size_t bytes_before = mallinfo2().uordblks;
+    AvlTree<SequenceMap> a_tree;
+    a_tree.bulkLoad(dataset.items.begin(), dataset.items.end());
+    const size_t tree_bytes = mallinfo2().uordblks - bytes_before;
+    const FrozenSequenceIndex index = Freeze(a_tree);
+
+    int find_recursive_call = 0;
+    int successful_query = 0;
+    Stopwatch find;
+    find.start();
+    for(int round = 0; round < kRounds; ++round)
+        for(string_view key : keys)
+            successful_query += a_tree.find(key, find_recursive_call);
+    find.stop();
+    Report("BM_Find/" + dataset.name + "/tree", double(kRounds) * keys.size(), find);
+
+    int visited = 0;
+    int frozen_successful_query = 0;
+    Stopwatch frozen;
+    frozen.start();
+    for(int round = 0; round < kRounds; ++round)
+        for(string_view key : keys)
+            frozen_successful_query += index.find(key, visited);
+    frozen.stop();
+    Report("BM_Find/" + dataset.name + "/frozen", double(kRounds) * keys.size(), frozen);
+    if(frozen_successful_query != successful_query)
+        cout<<"  MISMATCH between the tree and the frozen index"<<endl;
+    cout<<"  "<<tree_bytes<<" bytes in the tree, "<<index.bytes()<<" in the frozen index"<<endl;
+}
+
+// @dataset: the inputs.
+// Take a snapshot of a loaded tree, by copying an AvlTree and by sharing a
+// PersistentAvlTree, and insert into the persistent tree, which copies paths.
+void BenchSnapshot(const Dataset &dataset){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.items.size());
+    AvlTree<SequenceMap> a_tree;
+    PersistentAvlTree<SequenceMap> persistent_tree;
+    Stopwatch insert;
+    for(int round = 0; round < kRounds; ++round){
+        PersistentAvlTree<SequenceMap> fresh_tree;
+        insert.start();
+        for(const SequenceMap &item : dataset.items)
+            fresh_tree.insert(item);
+        insert.stop();
+        persistent_tree = std::move(fresh_tree);
+    }
+    Report("BM_Insert/" + dataset.name + "/persistent", double(kRounds) * dataset.items.size(), insert);
+    for(const SequenceMap &item : dataset.items)
+        a_tree.insert(item);
+
+    const int kSnapshots = max(1, kRounds / 10);
+    Stopwatch copy;
+    for(int round = 0; round < kSnapshots; ++round){
+        copy.start();
+        AvlTree<SequenceMap> snapshot(a_tree);
+        copy.stop();
+    }
+    Report("BM_Snapshot/" + dataset.name + "/copy", kSnapshots, copy);
+
+    int nodes = 0;
+    Stopwatch share;
+    share.start();
+    for(int round = 0; round < kSnapshots; ++round){
+        PersistentAvlTree<SequenceMap> snapshot = persistent_tree.snapshot();
+        nodes += snapshot.numberOfNodes();
+    }
+    share.stop();
+    Report("BM_Snapshot/" + dataset.name + "/persistent", kSnapshots, share);
+    if(nodes != kSnapshots * a_tree.numberOfNodes())
+        cout<<"  MISMATCH between the tree and the persistent tree"<<endl;
+}
+
+// @dataset: the inputs.
+// @workers: the pool the parallel union runs on.
+// Combine two trees, each holding every other item, by inserting the items of
+// one into the other, and with unionWith(), serially and on the workers.
+void BenchUnion(const Dataset &dataset, ThreadPool &workers){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.items.size());
+    AvlTree<SequenceMap> evens;
+    AvlTree<SequenceMap> odds;
+    for(size_t i = 0; i < dataset.items.size(); ++i)
+        (i % 2 == 0 ? evens : odds).insert(dataset.items[i]);
+    const string name = dataset.name;
+    const double operations = double(kRounds) * odds.numberOfNodes();
+
+    Stopwatch insert;
+    for(int round = 0; round < kRounds; ++round){
+        AvlTree<SequenceMap> a_tree(evens);
+        insert.start();
+        odds.forEach([&a_tree](const SequenceMap &x){ a_tree.insert(x); });
+        insert.stop();
+    }
+    Report("BM_Union/" + name + "/insert", operations, insert);
+
+    int nodes[2] = {0, 0};
+    for(int parallel = 0; parallel < 2; ++parallel){
+        Stopwatch combine;
+        for(int round = 0; round < kRounds; ++round){
+            AvlTree<SequenceMap> a_tree(evens);
+            AvlTree<SequenceMap> other(odds);
+            combine.start();
+            if(parallel)
+                a_tree.unionWith(std::move(other), workers);
+            else
+                a_tree.unionWith(std::move(other));
+            combine.stop();
+            nodes[parallel] = a_tree.numberOfNodes();
+        }
+        Report("BM_Union/" + name + (parallel ? "/parallel" : "/serial"), operations, combine);
+    }
+    if(nodes[0] != nodes[1])
+        cout<<"  MISMATCH between the serial and parallel unions"<<endl;
+}
+
+// @dataset: the inputs.
+// Insert every item, find every query and remove every item, in a plain tree
+// and in one that counts, then print what each kind of operation cost.
+void BenchStats(const Dataset &dataset){
+    typedef AvlTree<SequenceMap, NodePool, CountingStats> CountingTree;
+    const vector<string_view> keys(dataset.queries.begin(), dataset.queries.end());
+    vector<string_view> items;
+    for(const SequenceMap &item : dataset.items)
+        items.push_back(item.getRecognitionSequence());
+
+    int successful_query[2] = {0, 0};
+    Stopwatch plain;
+    plain.start();
+    {
+        AvlTree<SequenceMap> a_tree;
+        for(const SequenceMap &item : dataset.items)
+            a_tree.insert(item);
+        for(string_view key : keys)
+            successful_query[0] += a_tree.find(key);
+        for(string_view item : items)
+            a_tree.remove(item);
+    }
+    plain.stop();
+    Report("BM_Stats/" + dataset.name + "/none", double(dataset.items.size()) * 2 + keys.size(), plain);
+
+    CountingTree counting_tree;
+    Stopwatch counting;
+    counting.start();
+    for(const SequenceMap &item : dataset.items)
+        counting_tree.insert(item);
+    for(string_view key : keys)
+        successful_query[1] += counting_tree.find(key);
+    for(string_view item : items)
+        counting_tree.remove(item);
+    counting.stop();
+    Report("BM_Stats/" + dataset.name + "/counting", double(dataset.items.size()) * 2 + keys.size(), counting);
+    if(successful_query[0] != successful_query[1])
+        cout<<"  MISMATCH between the plain and counting trees"<<endl;
+    counting_tree.stats().print(cout);
+}
+
+// @dataset: the inputs.
+// @suffix: appended to the benchmark names, to tell the element types apart.
+// Run every tree benchmark on the dataset with an AvlTree of Element, which is
+// SequenceMap or a type constructible from one. Each benchmark repeats until it
+// has done about a million operations, so small datasets are timed fairly.
+template <typename Element>
+void BenchDataset(const Dataset &dataset, const string &suffix){
+    const int kRounds = max<size_t>(1, 1000000 / dataset.items.size());
+    const vector<string_view> keys(dataset.queries.begin(), dataset.queries.end());
+    const vector<Element> items(dataset.items.begin(), dataset.items.end());
+    const string name = dataset.name + suffix;
+
+    Stopwatch insert;
+    for(int round = 0; round < kRounds; ++round){
+        AvlTree<Element> a_tree;
+        insert.start();
+        for(const Element &item : items)
+            a_tree.insert(item);
+        insert.stop();
+    }
+    Report("BM_Insert/" + name, double(kRounds) * items.size(), insert);
+
+    AvlTree<Element> a_tree;
+    Stopwatch bulk_load;
+    for(int round = 0; round < kRounds; ++round){
+        bulk_load.start();
+        a_tree.bulkLoad(items.begin(), items.end());
+        bulk_load.stop();
+    }
+    Report("BM_BulkLoad/" + name, double(kRounds) * items.size(), bulk_load);
+
+    const int kFindRounds = max<size_t>(1, 1000000 / keys.size());
+    int find_recursive_call = 0;
+    int successful_query = 0;
+    Stopwatch find;
+    find.start();
+    for(int round = 0; round < kFindRounds; ++round)
+        for(string_view key : keys)
+            successful_query += a_tree.find(key, find_recursive_call);
+    find.stop();
+    Report("BM_Find/" + name, double(kFindRounds) * keys.size(), find);
+
+    vector<int> found(keys.size());
+    int batch_recursive_call = 0;
+    int batch_successful_query = 0;
+    Stopwatch find_batch;
+    find_batch.start();
+    for(int round = 0; round < kFindRounds; ++round)
+        batch_successful_query += a_tree.findBatch(keys.data(), keys.size(), found.data(), batch_recursive_call);
+    find_batch.stop();
+    Report("BM_FindBatch/" + name, double(kFindRounds) * keys.size(), find_batch);
+    if(batch_successful_query != successful_query || batch_recursive_call != find_recursive_call)
+        cout<<"  MISMATCH between find and findBatch"<<endl;
+
+    const int number_of_nodes = a_tree.numberOfNodes();
+    size_t enzymes = 0;
+    Stopwatch iterate;
+    for(int round = 0; round < kRounds; ++round){
+        iterate.start();
+        a_tree.forEach([&enzymes](const Element &x){ enzymes += x.getEnzymeCount(); });
+        iterate.stop();
+    }
+    Report("BM_Iterate/" + name, double(kRounds) * number_of_nodes, iterate);
+
+    Stopwatch remove;
+    for(int round = 0; round < kRounds; ++round){
+        AvlTree<Element> copy(a_tree);
+        int remove_recursive_call = 0;
+        remove.start();
+        for(const Element &item : items)
+            copy.remove(string_view(item.getRecognitionSequence()), remove_recursive_call);
+        remove.stop();
+    }
+    Report("BM_Remove/" + name, double(kRounds) * items.size(), remove);
+
+    Stopwatch teardown;
+    for(int round = 0; round < kRounds; ++round){
+        AvlTree<Element> copy(a_tree);
+        teardown.start();
+        copy.makeEmpty();
+        teardown.stop();
+    }
+    Report("BM_Teardown/" + name, double(kRounds) * number_of_nodes, teardown);
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 3 && argc != 4) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <queryfilename> [maxkeys]" << endl;
+        cout << "Synthetic datasets grow tenfold from 1000 keys up to maxkeys (default 1000000)." << endl;
+        return 0;
+    }
+    const string db_filename(argv[1]);
+    const string seq_filename(argv[2]);
+    const size_t max_keys = argc == 4 ? strtoull(argv[3], nullptr, 10) : 1000000;
+#ifdef MODIFIED_TREE
+    cout<<"Tree: AvlTree with direct double rotations (avl_tree_modified.h)"<<endl;
+#else
+    cout<<"Tree: AvlTree (avl_tree.h)"<<endl;
+#endif
+    cout<<left<<setw(32)<<"Benchmark"<<right<<setw(15)<<"Time"<<setw(12)<<"Allocs/op"<<setw(15)<<"RSS"<<endl;
+    cout<<string(74, '-')<<endl;
+    ThreadPool workers;
+    BenchParse(db_filename);
+    const Dataset rebase = RebaseDataset(db_filename, seq_filename);
+    BenchDataset<SequenceMap>(rebase, "");
+    BenchMemory(rebase);
+    BenchDataset<PackedSequenceMap>(rebase, "/packed");
+    BenchReverseComplement();
+    BenchBothStrands(rebase);
+    BenchFilter(rebase);
+    BenchFrozen(rebase);
+    BenchSnapshot(rebase);
+    BenchStats(rebase);
+    cout<<"  "<<AcronymTable::Global().size()<<" acronyms interned in "<<AcronymTable::Global().bytes()<<" bytes"<<endl;
+    for(size_t number_of_keys = 1000; number_of_keys <= max_keys; number_of_keys *= 10){
+        const Dataset synthetic = SyntheticDataset(number_of_keys);
+        BenchDataset<SequenceMap>(synthetic, "");
+        BenchMemory(synthetic);
+        BenchFilter(synthetic);
+        BenchFrozen(synthetic);
+        BenchUnion(synthetic, workers);
+        BenchSnapshot(synthetic);
+        BenchStats(synthetic);
+        BenchDataset<PackedSequenceMap>(synthetic, "/packed");
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+// File's Title: bloom_filter.h
+// Description: a blocked Bloom filter over key hashes, which AvlTree can keep in
+// front of its nodes to answer most lookups of absent keys without a search.
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// BlockedBloomFilter class
+//
+// CONSTRUCTION: zero parameter, holding no blocks; reset( ) sizes it
+//
+// ******************PUBLIC OPERATIONS*********************
+// void reset( n )          --> Empty the filter and size it for n keys
+// void clear( )            --> Empty the filter, keeping its size
+// void add( h )            --> Add the key with hash h
+// bool mayContain( h )     --> Return false only if no key with hash h was added
+// bool isSized( )          --> Return true once reset( ) has given it blocks
+// size_t capacity( )       --> Return the number of keys it is sized for
+// size_t added( )          --> Return the number of add( ) calls since it was emptied
+//
+// Every key sets one bit in each of the eight 64-bit words of a single 64-byte
+// block, chosen by the high half of its hash, so add( ) and mayContain( ) touch
+// one cache line. With BITS_PER_KEY bits per key, about 0.1% of absent keys
+// pass while the filter holds no more than capacity( ) keys. Keys cannot be
+// taken out; the owner rebuilds the filter when enough of them are gone.
+
+class BlockedBloomFilter
+{
+  public:
+    static const size_t BITS_PER_KEY = 16;
+
+    BlockedBloomFilter( ) : keyCapacity{ 0 }, keysAdded{ 0 }
+    { }
+
+    void reset( size_t n )
+    {
+        const size_t blocks = ( n * BITS_PER_KEY + BLOCK_BITS - 1 ) / BLOCK_BITS;
+        words.assign( ( blocks > 0 ? blocks : 1 ) * WORDS_PER_BLOCK, 0 );
+        keyCapacity = n;
+        keysAdded = 0;
+    }
+
+    void clear( )
+    {
+        words.assign( words.size( ), 0 );
+        keysAdded = 0;
+    }
+
+    void add( uint64_t h )
+    {
+        uint64_t *block = blockOf( h );
+        const uint64_t bits = spread( h );
+        for( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+            block[ i ] |= uint64_t( 1 ) << ( ( bits >> ( 6 * i ) ) & 63 );
+        ++keysAdded;
+    }
+
+    bool mayContain( uint64_t h ) const
+    {
+        const uint64_t *block = blockOf( h );
+        const uint64_t bits = spread( h );
+        uint64_t missing = 0;
+        for( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+            missing |= ~block[ i ] & ( uint64_t( 1 ) << ( ( bits >> ( 6 * i ) ) & 63 ) );
+        return missing == 0;
+    }
+
+    bool isSized( ) const
+    {
+        return !words.empty( );
+    }
+
+    size_t capacity( ) const
+    {
+        return keyCapacity;
+    }
+
+    size_t added( ) const
+    {
+        return keysAdded;
+    }
+
+  private:
+    static const size_t WORDS_PER_BLOCK = 8;
+    static const size_t BLOCK_BITS = 64 * WORDS_PER_BLOCK;
+
+    std::vector<uint64_t> words;
+    size_t keyCapacity;
+    size_t keysAdded;
+
+    /**
+     * Return the block of hash h: the high 32 bits scaled to the number of blocks.
+     */
+    uint64_t * blockOf( uint64_t h )
+    {
+        const uint64_t blocks = words.size( ) / WORDS_PER_BLOCK;
+        return &words[ ( ( h >> 32 ) * blocks >> 32 ) * WORDS_PER_BLOCK ];
+    }
+
+    const uint64_t * blockOf( uint64_t h ) const
+    {
+        return const_cast<BlockedBloomFilter *>( this )->blockOf( h );
+    }
+
+    /**
+     * Return 48 bits, six per word, mixed from all of h so they do not
+     * repeat the bits that picked the block.
+     */
+    static uint64_t spread( uint64_t h )
+    {
+        h *= 0x9E3779B97F4A7C15ULL;
+        return h ^ ( h >> 29 );
+    }
+};
+
+#endif
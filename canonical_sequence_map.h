@@ -0,0 +1,83 @@
+// File's Title: canonical_sequence_map.h
+// Description: CanonicalSequenceMap, a SequenceMap keyed by the canonical form of its
+// recognition sequence, so that one tree lookup finds the enzymes of both strands.
+
+#ifndef CANONICAL_SEQUENCE_MAP_H
+#define CANONICAL_SEQUENCE_MAP_H
+
+#include "key_prefix.h"
+#include "reverse_complement.h"
+#include "sequence_map.h"
+
+#include <string_view>
+#include <vector>
+
+// CanonicalSequenceMap: the enzymes whose recognition sequence has a given canonical
+// form (see Canonicalize()), each with the strand it was found on: '+' if its
+// recognition sequence is the key, '-' if it is the key's reverse complement.
+// An enzyme and the enzyme recognizing the reverse complement of its sequence
+// thus share one node, and FindBothStrands() answers a query for either strand
+// with one lookup.
+class CanonicalSequenceMap : public SequenceMap{
+  public:
+    CanonicalSequenceMap(std::string_view a_rec_seq, std::string_view an_enz_acro)
+        : CanonicalSequenceMap(Canonicalize(a_rec_seq), an_enz_acro){ }
+
+    //Merges the other_sequence's enzyme acronyms and strands with the object's
+    //Pre-condition: the two canonical recognition sequences are equal
+    void Merge(const CanonicalSequenceMap &other_sequence){
+        SequenceMap::Merge(other_sequence);
+        strands_.insert(strands_.end(), other_sequence.strands_.begin(), other_sequence.strands_.end());
+    }
+
+    // return the strand of the i-th enzyme acronym, '+' or '-'
+    char getEnzymeStrand(size_t i) const{
+        return strands_[i];
+    }
+
+  private:
+    CanonicalSequenceMap(const CanonicalKey &key, std::string_view an_enz_acro)
+        : SequenceMap(key.sequence, an_enz_acro), strands_(1, key.strand){ }
+
+    std::vector<char> strands_;
+};
+
+//AvlTree keeps the first bytes of the canonical recognition sequence inline in each node
+template <>
+struct KeyPrefixTraits<CanonicalSequenceMap>{
+    typedef StringPrefix Prefix;
+
+    static Prefix of(const CanonicalSequenceMap &x){
+        return StringPrefix::of(x.getRecognitionSequence());
+    }
+
+    static Prefix of(std::string_view x){
+        return StringPrefix::of(x);
+    }
+
+    static uint64_t hash(const CanonicalSequenceMap &x){
+        return HashKey(x.getRecognitionSequence());
+    }
+
+    static uint64_t hash(std::string_view x){
+        return HashKey(x);
+    }
+};
+
+// @a_tree: a tree of CanonicalSequenceMap.
+// @query: a recognition sequence as read on the forward strand.
+// @visit: called as visit(enzyme_acronym, strand) for every enzyme whose
+//  recognition sequence is query (strand '+') or its reverse complement ('-').
+// Return the number of enzymes visited. Both strands take one lookup.
+template <typename TreeType, typename Visitor>
+int FindBothStrands(const TreeType &a_tree, std::string_view query, Visitor visit){
+    const CanonicalKey key = Canonicalize(query);
+    auto itr = a_tree.lower_bound(key.sequence);
+    if(itr == a_tree.end() || itr->getRecognitionSequence() != key.sequence)
+        return 0;
+    for(size_t i = 0; i < itr->getEnzymeCount(); ++i)
+        visit(itr->getEnzymeAcronym(i), itr->getEnzymeStrand(i) == key.strand ? '+' : '-');
+    return int(itr->getEnzymeCount());
+}
+
+#endif
@@ -0,0 +1,591 @@
+// File's Title: concurrent_avl_tree.h
+// Description: an AVL tree for read-mostly use from many threads. Readers never
+// lock; writers are serialized, copy the path they change and publish a new root,
+// and the replaced nodes are freed once no reader can still be looking at them.
+
+#ifndef CONCURRENT_AVL_TREE_H
+#define CONCURRENT_AVL_TREE_H
+
+#include "dsexceptions.h"
+#include "key_prefix.h"
+#include "sequence_map.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// EpochDomain class
+//
+// Process-wide epoch-based reclamation shared by every ConcurrentAvlTree.
+// A reader announces the global epoch in its own slot while it is inside a
+// read section and clears the slot when it leaves. A writer tags what it
+// unlinks with the epoch it unlinked it in and then advances the epoch;
+// a tagged node may be freed once every announced epoch is newer than its tag.
+//
+// ******************PUBLIC OPERATIONS*********************
+// ReadGuard guard;          --> Stay in a read section while guard lives
+// uint64_t advance( )       --> Start a new epoch; return the one that ended
+// uint64_t oldestReader( )  --> Return the oldest announced epoch, or UINT64_MAX
+// ******************ERRORS********************************
+// Throws ArrayIndexOutOfBoundsException if more than MAX_THREADS threads
+// are reading at the same time
+
+class EpochDomain
+{
+  public:
+    static const int MAX_THREADS = 256;
+
+    static EpochDomain & instance( )
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /**
+     * RAII read section. Nested guards on one thread share the outer section.
+     */
+    class ReadGuard
+    {
+      public:
+        ReadGuard( )
+        {
+            ThreadRecord & record = threadRecord( );
+            if( record.depth++ == 0 )
+            {
+                if( record.slot == nullptr )
+                    record.slot = instance( ).acquireSlot( );
+                record.slot->epoch.store( instance( ).epoch.load( ) );
+            }
+        }
+
+        ~ReadGuard( )
+        {
+            ThreadRecord & record = threadRecord( );
+            if( --record.depth == 0 )
+                record.slot->epoch.store( 0 );
+        }
+
+        ReadGuard( const ReadGuard & rhs ) = delete;
+        ReadGuard & operator=( const ReadGuard & rhs ) = delete;
+    };
+
+    uint64_t advance( )
+    {
+        return epoch.fetch_add( 1 );
+    }
+
+    uint64_t oldestReader( ) const
+    {
+        uint64_t oldest = UINT64_MAX;
+        for( int i = 0; i < MAX_THREADS; ++i )
+        {
+            uint64_t announced = slots[ i ].epoch.load( );
+            if( announced != 0 && announced < oldest )
+                oldest = announced;
+        }
+        return oldest;
+    }
+
+  private:
+    struct alignas( 64 ) Slot
+    {
+        std::atomic<uint64_t> epoch{ 0 };
+        std::atomic<bool>     used{ false };
+    };
+
+    // A thread keeps its slot until it exits
+    struct ThreadRecord
+    {
+        Slot *slot = nullptr;
+        int  depth = 0;
+
+        ~ThreadRecord( )
+        {
+            if( slot != nullptr )
+                slot->used.store( false );
+        }
+    };
+
+    std::atomic<uint64_t> epoch{ 1 };
+    Slot slots[ MAX_THREADS ];
+
+    EpochDomain( ) { }
+
+    static ThreadRecord & threadRecord( )
+    {
+        thread_local ThreadRecord record;
+        return record;
+    }
+
+    Slot * acquireSlot( )
+    {
+        for( int i = 0; i < MAX_THREADS; ++i )
+            if( !slots[ i ].used.exchange( true ) )
+                return &slots[ i ];
+        throw ArrayIndexOutOfBoundsException{ };
+    }
+};
+
+// ConcurrentAvlTree class
+//
+// CONSTRUCTION: zero parameter
+//
+// ******************READER OPERATIONS (lock-free)*********
+// bool contains( x )     --> Return true if x is present
+// void findRecoSeq( x )  --> Find x and print its enzyme acronym
+// int find( x, visited ) --> Return 1 if item is found, else 0
+// int numberOfNodes()    --> Return number of nodes
+// void forEach( visit )  --> Call visit( x ) on every item in sorted order
+// bool isEmpty( )        --> Return true if empty; else false
+// ******************WRITER OPERATIONS (serialized)********
+// void insert( x )       --> Insert x; duplicates will be merged
+// void remove( x )       --> Remove x
+// int remove( x, visited ) --> Return 1 if item is removed, else 0
+// void makeEmpty( )      --> Remove all items
+//
+// Every reader operation runs against one published version of the tree, so
+// it sees either all or none of any concurrent update. find( ) and remove( )
+// count the nodes they visit exactly as AvlTree's do. The tree must not be
+// destroyed while readers are still using it.
+
+template <typename Comparable>
+class ConcurrentAvlTree
+{
+  public:
+    ConcurrentAvlTree( ) : root{ nullptr }, stamp{ 0 }
+    { }
+
+    ConcurrentAvlTree( const ConcurrentAvlTree & rhs ) = delete;
+    ConcurrentAvlTree & operator=( const ConcurrentAvlTree & rhs ) = delete;
+
+    ~ConcurrentAvlTree( )
+    {
+        freeSubtree( root.load( ) );
+        for( Retired & r : retired )
+            delete r.node;
+    }
+
+    bool contains( const Comparable & x ) const
+    {
+        EpochDomain::ReadGuard guard;
+        return search( x, root.load( ) ) != nullptr;
+    }
+
+    /**
+     * Find the item in the tree and print the associated enzyme acronym.
+     */
+    void findRecoSeq( std::string_view x ) const
+    {
+        EpochDomain::ReadGuard guard;
+        const Node *t = search( x, root.load( ) );
+        if( t == nullptr )
+            cout<<"Not Found"<<endl;
+        else
+            t->element.printEnzymeAcronym( );
+    }
+
+    /**
+     * Return 1 if item is found, else 0. Count the nodes visited.
+     */
+    int find( std::string_view x, int &find_recursive_call ) const
+    {
+        EpochDomain::ReadGuard guard;
+        const Prefix xp = PrefixTraits::of( x );
+        const Node *t = root.load( );
+        while( true )
+        {
+            ++find_recursive_call;
+            if( t == nullptr )
+                return 0;
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+                t = t->right;
+            else
+                return 1;
+        }
+    }
+
+    bool isEmpty( ) const
+    {
+        return root.load( ) == nullptr;
+    }
+
+    int numberOfNodes( ) const
+    {
+        int nodes = 0;
+        forEach( [ &nodes ]( const Comparable & x ) { ++nodes; } );
+        return nodes;
+    }
+
+    /**
+     * Call visit( x ) on every item of one version in sorted order.
+     */
+    template <typename Visitor>
+    void forEach( Visitor visit ) const
+    {
+        EpochDomain::ReadGuard guard;
+        const Node *path[ MAX_HEIGHT ];
+        int depth = 0;
+        const Node *t = root.load( );
+        while( t != nullptr || depth > 0 )
+        {
+            if( t != nullptr )
+            {
+                path[ depth++ ] = t;
+                t = t->left;
+            }
+            else
+            {
+                t = path[ --depth ];
+                visit( t->element );
+                t = t->right;
+            }
+        }
+    }
+
+    void insert( const Comparable & x )
+    {
+        std::lock_guard<std::mutex> lock{ writer };
+        beginWrite( );
+        publish( insert( x, root.load( ) ) );
+    }
+
+    void insert( Comparable && x )
+    {
+        std::lock_guard<std::mutex> lock{ writer };
+        beginWrite( );
+        publish( insert( std::move( x ), root.load( ) ) );
+    }
+
+    void remove( const Comparable & x )
+    {
+        std::lock_guard<std::mutex> lock{ writer };
+        if( search( x, root.load( ) ) == nullptr )
+            return;   // Item not found; do nothing
+        beginWrite( );
+        publish( remove( x, root.load( ) ) );
+    }
+
+    /**
+     * Return 1 if item is removed, else 0. Count the nodes visited as
+     * AvlTree::remove( x, remove_recursive_call ) does: the nodes down to x,
+     * and for a node with two children the nodes down to the smallest item
+     * of its right subtree, so both trees report the same counts.
+     */
+    int remove( std::string_view x, int &remove_recursive_call )
+    {
+        std::lock_guard<std::mutex> lock{ writer };
+        const Prefix xp = PrefixTraits::of( x );
+        const Node *t = root.load( );
+        while( true )
+        {
+            ++remove_recursive_call;
+            if( t == nullptr )
+                return 0;
+            int order = compare( x, xp, t );
+            if( order == 0 )
+                break;
+            t = order < 0 ? t->left : t->right;
+        }
+        if( t->left != nullptr && t->right != nullptr )   // Two children
+            for( const Node *successor = t->right; successor != nullptr; successor = successor->left )
+                ++remove_recursive_call;
+        beginWrite( );
+        publish( remove( x, root.load( ) ) );
+        return 1;
+    }
+
+    void makeEmpty( )
+    {
+        std::lock_guard<std::mutex> lock{ writer };
+        beginWrite( );
+        retireSubtree( root.load( ) );
+        publish( nullptr );
+    }
+
+  private:
+    typedef KeyPrefixTraits<Comparable> PrefixTraits;
+    typedef typename PrefixTraits::Prefix Prefix;
+
+    // Nodes are never changed once a reader can reach them. A writer may
+    // only change nodes it built during the current update, which carry
+    // the current stamp.
+    struct Node
+    {
+        Node       *left;
+        Node       *right;
+        Prefix     prefix;
+        int        height;
+        uint64_t   stamp;
+        Comparable element;
+
+        template <typename Item>
+        Node( Item && ele, Node *lt, Node *rt, int h, uint64_t s )
+          : left{ lt }, right{ rt }, prefix( PrefixTraits::of( ele ) ), height{ h }, stamp{ s },
+            element{ std::forward<Item>( ele ) } { }
+    };
+
+    struct Retired
+    {
+        uint64_t epoch;
+        Node     *node;
+    };
+
+    static const int MAX_HEIGHT = 96;
+    static const int ALLOWED_IMBALANCE = 1;
+
+    std::atomic<Node *> root;
+    std::mutex writer;
+    uint64_t stamp;                 // Stamp of the update in progress
+    std::vector<Node *> unlinked;   // Shared nodes the update has replaced
+    std::vector<Retired> retired;   // Replaced nodes readers may still hold
+
+    template <typename Key>
+    int compare( const Key & x, const Prefix & xp, const Node *t ) const
+    {
+        int order = Prefix::compare( xp, t->prefix );
+        if( order != PREFIX_UNDECIDED )
+            return order;
+        if( x < t->element )
+            return -1;
+        if( t->element < x )
+            return 1;
+        return 0;
+    }
+
+    template <typename Key>
+    const Node * search( const Key & x, const Node *t ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        while( t != nullptr )
+        {
+            int order = compare( x, xp, t );
+            if( order < 0 )
+                t = t->left;
+            else if( order > 0 )
+                t = t->right;
+            else
+                return t;
+        }
+        return nullptr;
+    }
+
+    void beginWrite( )
+    {
+        ++stamp;
+    }
+
+    /**
+     * Make newRoot visible to readers, then hand the nodes it replaced to
+     * the epoch domain and free whatever no reader can reach any more.
+     */
+    void publish( Node *newRoot )
+    {
+        root.store( newRoot );
+        EpochDomain & domain = EpochDomain::instance( );
+        uint64_t ended = domain.advance( );
+        for( Node *node : unlinked )
+            retired.push_back( Retired{ ended, node } );
+        unlinked.clear( );
+
+        uint64_t oldest = domain.oldestReader( );
+        size_t kept = 0;
+        for( Retired & r : retired )
+            if( r.epoch < oldest )
+                delete r.node;
+            else
+                retired[ kept++ ] = r;
+        retired.resize( kept );
+    }
+
+    bool isFresh( const Node *t ) const
+    {
+        return t->stamp == stamp;
+    }
+
+    /**
+     * Return a node of this update that can stand in for t: t itself if
+     * this update built it, else a copy, with t queued for retirement.
+     */
+    Node * own( Node *t )
+    {
+        if( isFresh( t ) )
+            return t;
+        unlinked.push_back( t );
+        return new Node{ t->element, t->left, t->right, t->height, stamp };
+    }
+
+    /**
+     * Drop t from the tree: free it now if no reader has seen it.
+     */
+    void discard( Node *t )
+    {
+        if( isFresh( t ) )
+            delete t;
+        else
+            unlinked.push_back( t );
+    }
+
+    template <typename Item>
+    Node * insert( Item && x, Node *t )
+    {
+        if( t == nullptr )
+            return new Node{ std::forward<Item>( x ), nullptr, nullptr, 0, stamp };
+        Node *copy;
+        if( x < t->element )
+        {
+            Node *left = insert( std::forward<Item>( x ), t->left );
+            copy = own( t );
+            copy->left = left;
+        }
+        else if( t->element < x )
+        {
+            Node *right = insert( std::forward<Item>( x ), t->right );
+            copy = own( t );
+            copy->right = right;
+        }
+        else
+        {
+            copy = own( t );
+            copy->element.Merge( x );
+            return copy;
+        }
+        return balance( copy );
+    }
+
+    /**
+     * Remove x, which must be present, from the subtree t.
+     * Return the new root of the subtree.
+     */
+    template <typename Key>
+    Node * remove( const Key & x, Node *t )
+    {
+        Node *copy;
+        if( x < t->element )
+        {
+            Node *left = remove( x, t->left );
+            copy = own( t );
+            copy->left = left;
+        }
+        else if( t->element < x )
+        {
+            Node *right = remove( x, t->right );
+            copy = own( t );
+            copy->right = right;
+        }
+        else if( t->left != nullptr && t->right != nullptr ) // Two children
+        {
+            copy = own( t );
+            copy->right = removeMin( t->right, copy );
+            copy->prefix = PrefixTraits::of( copy->element );
+        }
+        else
+        {
+            Node *child = ( t->left != nullptr ) ? t->left : t->right;
+            discard( t );
+            return child;
+        }
+        return balance( copy );
+    }
+
+    /**
+     * Remove the smallest item of subtree t and copy it into target.
+     * Return the new root of the subtree.
+     */
+    Node * removeMin( Node *t, Node *target )
+    {
+        if( t->left == nullptr )
+        {
+            target->element = t->element;   // Readers may still be looking at t
+            Node *right = t->right;
+            discard( t );
+            return right;
+        }
+        Node *left = removeMin( t->left, target );
+        Node *copy = own( t );
+        copy->left = left;
+        return balance( copy );
+    }
+
+    int height( const Node *t ) const
+    {
+        return t == nullptr ? -1 : t->height;
+    }
+
+    void fixHeight( Node *t )
+    {
+        t->height = std::max( height( t->left ), height( t->right ) ) + 1;
+    }
+
+    /**
+     * Rebalance the fresh node t; any shared node a rotation has to change
+     * is copied first. Return the new root of the subtree.
+     */
+    Node * balance( Node *t )
+    {
+        if( height( t->left ) - height( t->right ) > ALLOWED_IMBALANCE )
+        {
+            if( height( t->left->left ) < height( t->left->right ) )
+                t->left = rotateWithRightChild( own( t->left ) );
+            t = rotateWithLeftChild( t );
+        }
+        else if( height( t->right ) - height( t->left ) > ALLOWED_IMBALANCE )
+        {
+            if( height( t->right->right ) < height( t->right->left ) )
+                t->right = rotateWithLeftChild( own( t->right ) );
+            t = rotateWithRightChild( t );
+        }
+        else
+            fixHeight( t );
+        return t;
+    }
+
+    Node * rotateWithLeftChild( Node *k2 )
+    {
+        Node *k1 = own( k2->left );
+        k2->left = k1->right;
+        k1->right = k2;
+        fixHeight( k2 );
+        fixHeight( k1 );
+        return k1;
+    }
+
+    Node * rotateWithRightChild( Node *k1 )
+    {
+        Node *k2 = own( k1->right );
+        k1->right = k2->left;
+        k2->left = k1;
+        fixHeight( k1 );
+        fixHeight( k2 );
+        return k2;
+    }
+
+    void retireSubtree( Node *t )
+    {
+        if( t != nullptr )
+        {
+            retireSubtree( t->left );
+            retireSubtree( t->right );
+            unlinked.push_back( t );
+        }
+    }
+
+    void freeSubtree( Node *t )
+    {
+        if( t != nullptr )
+        {
+            freeSubtree( t->left );
+            freeSubtree( t->right );
+            delete t;
+        }
+    }
+};
+
+#endif
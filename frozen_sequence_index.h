@@ -0,0 +1,213 @@
+// File's Title: frozen_sequence_index.h
+// Description: FrozenSequenceIndex, an immutable copy of a tree of SequenceMap laid out
+// in Eytzinger (breadth-first) order and searched without branching on the keys.
+
+#ifndef FROZEN_SEQUENCE_INDEX_H
+#define FROZEN_SEQUENCE_INDEX_H
+
+#include "key_prefix.h"
+#include "sequence_map.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// FrozenSequenceIndex class
+//
+// CONSTRUCTION: through Freeze( a_tree ), from any tree of SequenceMap
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool contains( x )     --> Return true if recognition sequence x is present
+// void findRecoSeq( x )  --> Find x and print its enzyme acronym
+// int numberOfNodes()    --> Return number of sequences
+// int find( x, visited ) --> Return 1 if x is found, else 0; count levels visited
+// void forEach( visit )  --> Call visit( sequence, acronyms ) in sorted order
+// size_t bytes( )        --> Return the heap bytes the index holds
+//
+// The search reads one array of 8-byte fingerprints, the StringPrefix of each
+// sequence, stored as the implicit tree whose node k has children 2k and 2k + 1.
+// A step compares two integers and turns left or right with arithmetic, not a
+// branch, so no search mispredicts, and the fingerprints of the node's great-
+// grandchildren share one cache line that is prefetched three levels ahead.
+// Only two fingerprints that tie on seven bytes send the step to the sequences
+// themselves, which sit in sorted order in one character arena with their
+// acronyms in another. The answers are those of the tree it was frozen from.
+// Every search runs to a leaf, so the index pays off on trees that outgrow the
+// cache; on one as small as the REBASE tree, which stays cached, the pointer
+// tree stops early on the sequences it finds and is faster.
+
+class FrozenSequenceIndex{
+  public:
+    FrozenSequenceIndex() : size_{0}, fingerprint_base_{0}{ }
+
+    int numberOfNodes() const{
+        return int(size_);
+    }
+
+    bool contains(std::string_view x) const{
+        int visited = 0;
+        return find(x, visited);
+    }
+
+    int find(std::string_view x, int &visited) const{
+        return Search(x, visited) != NONE;
+    }
+
+    // Find x and print its enzyme acronyms like SequenceMap::printEnzymeAcronym()
+    // Else print "Not Found"
+    void findRecoSeq(std::string_view x) const{
+        int visited = 0;
+        const uint32_t found = Search(x, visited);
+        if(found == NONE){
+            std::cout<<"Not Found"<<std::endl;
+            return;
+        }
+        for(uint32_t i = first_acronym_[found]; i < first_acronym_[found + 1]; ++i)
+            std::cout<<Acronym(i)<<" ";
+        std::cout<<std::endl;
+    }
+
+    // @visit: called as visit(recognition_sequence, acronyms) for every sequence
+    //  in sorted order, where acronyms is a vector of views into the index.
+    template <typename Visitor>
+    void forEach(Visitor visit) const{
+        std::vector<std::string_view> acronyms;
+        for(uint32_t rank = 0; rank < size_; ++rank){
+            acronyms.clear();
+            for(uint32_t i = first_acronym_[rank]; i < first_acronym_[rank + 1]; ++i)
+                acronyms.push_back(Acronym(i));
+            visit(Sequence(rank), acronyms);
+        }
+    }
+
+    size_t bytes() const{
+        return fingerprint_storage_.capacity() * sizeof(uint64_t) + ranks_.capacity() * sizeof(uint32_t)
+            + sequence_offsets_.capacity() * sizeof(uint32_t) + sequences_.capacity()
+            + first_acronym_.capacity() * sizeof(uint32_t) + acronym_offsets_.capacity() * sizeof(uint32_t)
+            + acronyms_.capacity();
+    }
+
+    template <typename TreeType>
+    friend FrozenSequenceIndex Freeze(const TreeType &a_tree);
+
+  private:
+    static const uint32_t NONE = 0xFFFFFFFF;
+    // A step at node k prefetches node PREFETCH_STRIDE * k, the first of its
+    // eight great-grandchildren, which fill one 64-byte line of fingerprints
+    static const size_t PREFETCH_STRIDE = 8;
+    static const size_t CACHE_LINE = 64;
+
+    uint32_t size_;
+    // fingerprint_storage_[ fingerprint_base_ + k ] is node k, for k in [ 1, size_ ];
+    // the base puts node 0 at the start of a cache line, and so every line of
+    // eight great-grandchildren too. An offset, not a pointer, so copies work
+    std::vector<uint64_t> fingerprint_storage_;
+    size_t fingerprint_base_;
+    std::vector<uint32_t> ranks_;               // Sorted rank of node k
+    std::vector<uint32_t> sequence_offsets_;    // Sequence of rank r: [ r ], [ r + 1 ) in sequences_
+    std::string sequences_;
+    std::vector<uint32_t> first_acronym_;       // Acronyms of rank r: [ r ], [ r + 1 ) in acronym_offsets_
+    std::vector<uint32_t> acronym_offsets_;     // Acronym i: [ i ], [ i + 1 ) in acronyms_
+    std::string acronyms_;
+
+    const uint64_t *Fingerprints() const{
+        return fingerprint_storage_.data() + fingerprint_base_;
+    }
+
+    std::string_view Sequence(uint32_t rank) const{
+        return std::string_view(sequences_.data() + sequence_offsets_[rank],
+                                sequence_offsets_[rank + 1] - sequence_offsets_[rank]);
+    }
+
+    std::string_view Acronym(uint32_t i) const{
+        return std::string_view(acronyms_.data() + acronym_offsets_[i], acronym_offsets_[i + 1] - acronym_offsets_[i]);
+    }
+
+    // Return the sorted rank of x, or NONE; count one visit per level.
+    uint32_t Search(std::string_view x, int &visited) const{
+        const uint64_t key = StringPrefix::of(x).bits;
+        const uint64_t *fingerprints = Fingerprints();
+        // Fingerprints tie without settling the order only when both sequences
+        // are longer than seven characters, and then the length byte is 8
+        const bool key_may_tie = (key & 0xFF) == 8;
+        size_t k = 1;
+        while(k <= size_){
+            __builtin_prefetch(fingerprints + PREFETCH_STRIDE * k);
+            ++visited;
+            const uint64_t fingerprint = fingerprints[k];
+            size_t less = fingerprint < key;
+            if(key_may_tie && fingerprint == key)
+                less = Sequence(ranks_[k]) < x;
+            k = 2 * k + less;
+        }
+        // k went past a leaf; the right turns since its last left turn lead
+        // away from the lower bound, so drop them and that left turn
+        k >>= __builtin_ctzll(~uint64_t(k)) + 1;
+        if(k == 0 || Sequence(ranks_[k]) != x)
+            return NONE;
+        return ranks_[k];
+    }
+};
+
+// @a_tree: a tree of SequenceMap, or anything else whose forEach() visits
+//  SequenceMap items in sorted order.
+// Return an immutable index of the tree's sequences and acronyms. The tree is
+// only read, and may be emptied or destroyed afterwards.
+template <typename TreeType>
+FrozenSequenceIndex Freeze(const TreeType &a_tree){
+    FrozenSequenceIndex index;
+    std::vector<uint64_t> sorted_fingerprints;
+    index.sequence_offsets_.push_back(0);
+    index.first_acronym_.push_back(0);
+    index.acronym_offsets_.push_back(0);
+    a_tree.forEach([&](const SequenceMap &x){
+        const std::string &sequence = x.getRecognitionSequence();
+        sorted_fingerprints.push_back(StringPrefix::of(sequence).bits);
+        index.sequences_ += sequence;
+        index.sequence_offsets_.push_back(uint32_t(index.sequences_.size()));
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i){
+            index.acronyms_ += x.getEnzymeAcronym(i);
+            index.acronym_offsets_.push_back(uint32_t(index.acronyms_.size()));
+        }
+        index.first_acronym_.push_back(uint32_t(index.acronym_offsets_.size() - 1));
+    });
+    const size_t n = sorted_fingerprints.size();
+    index.size_ = uint32_t(n);
+
+    // Room for nodes 0 .. n and for sliding node 0 onto a line boundary
+    const size_t words_per_line = FrozenSequenceIndex::CACHE_LINE / sizeof(uint64_t);
+    index.fingerprint_storage_.assign(n + 1 + words_per_line, 0);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(index.fingerprint_storage_.data());
+    index.fingerprint_base_ = ((FrozenSequenceIndex::CACHE_LINE - address % FrozenSequenceIndex::CACHE_LINE)
+                               % FrozenSequenceIndex::CACHE_LINE) / sizeof(uint64_t);
+    uint64_t *fingerprints = index.fingerprint_storage_.data() + index.fingerprint_base_;
+    index.ranks_.assign(n + 1, 0);
+
+    // Visit the implicit tree in order, handing out ranks 0, 1, ... as we go:
+    // start at the leftmost node; from node k, go to the leftmost node of its
+    // right subtree if it has one, else up past every right child to the parent
+    uint32_t rank = 0;
+    size_t k = 1;
+    while(2 * k <= n)
+        k *= 2;
+    while(n > 0 && k != 0){
+        fingerprints[k] = sorted_fingerprints[rank];
+        index.ranks_[k] = rank++;
+        if(2 * k + 1 <= n){
+            k = 2 * k + 1;
+            while(2 * k <= n)
+                k *= 2;
+        }
+        else{
+            while(k & 1)
+                k >>= 1;
+            k >>= 1;
+        }
+    }
+    return index;
+}
+
+#endif
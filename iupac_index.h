@@ -0,0 +1,212 @@
+// File's Title: iupac_index.h
+// Description: matches concrete DNA k-mers against the degenerate IUPAC recognition
+// sequences of an enzyme set, using per-position base bitmasks compiled from a tree.
+
+#ifndef IUPAC_INDEX_H
+#define IUPAC_INDEX_H
+
+#include "sequence_map.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Return the set of bases an IUPAC code stands for, as A = 1, C = 2, G = 4, T = 8,
+// or 0 for a character that is not a nucleotide code. Case is ignored; U is T.
+inline uint8_t IupacMask(char code){
+    switch(code | 0x20){
+      case 'a': return 1;
+      case 'c': return 2;
+      case 'g': return 4;
+      case 't': case 'u': return 8;
+      case 'r': return 1 | 4;
+      case 'y': return 2 | 8;
+      case 's': return 2 | 4;
+      case 'w': return 1 | 8;
+      case 'k': return 4 | 8;
+      case 'm': return 1 | 2;
+      case 'b': return 2 | 4 | 8;
+      case 'd': return 1 | 4 | 8;
+      case 'h': return 1 | 2 | 8;
+      case 'v': return 1 | 2 | 4;
+      case 'n': return 1 | 2 | 4 | 8;
+      default: return 0;
+    }
+}
+
+// Return 0, 1, 2 or 3 for the concrete base A, C, G or T, else -1.
+inline int BaseIndex(char base){
+    switch(IupacMask(base)){
+      case 1: return 0;
+      case 2: return 1;
+      case 4: return 2;
+      case 8: return 3;
+      default: return -1;
+    }
+}
+
+// Return the IUPAC code for the complementary bases of code: A <-> T, C <-> G,
+// R <-> Y, K <-> M, B <-> V, D <-> H; S, W and N are their own complements.
+// Case is kept; any other character is returned unchanged.
+constexpr char IupacComplement(char code){
+    const char lower = code | 0x20;
+    char complement = lower;
+    switch(lower){
+      case 'a': complement = 't'; break;
+      case 't': case 'u': complement = 'a'; break;
+      case 'c': complement = 'g'; break;
+      case 'g': complement = 'c'; break;
+      case 'r': complement = 'y'; break;
+      case 'y': complement = 'r'; break;
+      case 'k': complement = 'm'; break;
+      case 'm': complement = 'k'; break;
+      case 'b': complement = 'v'; break;
+      case 'v': complement = 'b'; break;
+      case 'd': complement = 'h'; break;
+      case 'h': complement = 'd'; break;
+      case 's': case 'w': case 'n': complement = lower; break;
+      default: return code;
+    }
+    return code == lower ? complement : complement & ~0x20;
+}
+
+// Return the reverse complement of an IUPAC sequence: the pattern as it reads on
+// the other strand.
+inline std::string IupacReverseComplement(std::string_view sequence){
+    std::string reverse(sequence.rbegin(), sequence.rend());
+    for(char &code : reverse)
+        code = IupacComplement(code);
+    return reverse;
+}
+
+// Return the recognition sequence without its cut marks ('), i.e. the bases it matches.
+inline std::string StripCutMarks(std::string_view recognition_sequence){
+    std::string pattern;
+    pattern.reserve(recognition_sequence.size());
+    for(char c : recognition_sequence)
+        if(c != '\'')
+            pattern += c;
+    return pattern;
+}
+
+// Return true if the concrete k-mer matches the degenerate pattern position by position.
+// The one-at-a-time test that IupacIndex replaces; kept as the reference.
+inline bool IupacMatches(std::string_view pattern, std::string_view kmer){
+    if(pattern.size() != kmer.size())
+        return false;
+    for(size_t i = 0; i < pattern.size(); ++i){
+        int base = BaseIndex(kmer[i]);
+        if(base < 0 || !(IupacMask(pattern[i]) >> base & 1))
+            return false;
+    }
+    return true;
+}
+
+// IupacIndex class
+//
+// CONSTRUCTION: empty, or from any tree of SequenceMap with forEach( )
+//
+// ******************PUBLIC OPERATIONS*********************
+// void add( x )                    --> Index the recognition sequence of x
+// size_t numberOfPatterns( )       --> Return the number of indexed patterns
+// int findMatches( kmer, visit )   --> Call visit( seq, acronym ) for every enzyme
+//                                      whose pattern matches kmer; return the patterns matched
+//
+// Patterns are bucketed by length. Within a bucket, each block of 64 patterns
+// keeps one word per (position, base): bit j is set if pattern j accepts that
+// base there. A k-mer is matched by ANDing the words its bases select, one per
+// position, so 64 patterns are tested at once and a block is abandoned as soon
+// as its word runs out of bits.
+class IupacIndex{
+  public:
+    IupacIndex(){ }
+
+    template <typename TreeType>
+    explicit IupacIndex(const TreeType &a_tree){
+        a_tree.forEach([this](const SequenceMap &x){ add(x); });
+    }
+
+    // @x: a recognition sequence and its enzymes. The index keeps its own copy.
+    // Sequences with no bases left after removing the cut marks are ignored.
+    void add(const SequenceMap &x){
+        const std::string pattern = StripCutMarks(x.getRecognitionSequence());
+        if(pattern.empty())
+            return;
+        Pattern entry;
+        entry.recognition_sequence = x.getRecognitionSequence();
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            entry.enzyme_acronyms.emplace_back(x.getEnzymeAcronym(i));
+        patterns_.push_back(std::move(entry));
+
+        const size_t length = pattern.size();
+        if(buckets_.size() <= length)
+            buckets_.resize(length + 1);
+        Bucket &bucket = buckets_[length];
+        const size_t slot = bucket.patterns.size();
+        if(slot % 64 == 0)
+            bucket.accepts.resize(bucket.accepts.size() + length * 4, 0);
+        bucket.patterns.push_back(patterns_.size() - 1);
+
+        uint64_t *block = &bucket.accepts[slot / 64 * length * 4];
+        for(size_t i = 0; i < length; ++i){
+            const uint8_t mask = IupacMask(pattern[i]);
+            for(int base = 0; base < 4; ++base)
+                if(mask >> base & 1)
+                    block[i * 4 + base] |= uint64_t(1) << (slot % 64);
+        }
+    }
+
+    size_t numberOfPatterns() const{
+        return patterns_.size();
+    }
+
+    // @kmer: a concrete DNA sequence of A, C, G and T, in either case.
+    // @visit: called as visit(recognition_sequence, enzyme_acronym) for every
+    //  enzyme of every matching pattern. Both are views into the index.
+    // Return the number of matching patterns; 0 if kmer is not concrete DNA.
+    template <typename Visitor>
+    int findMatches(std::string_view kmer, Visitor visit) const{
+        const size_t length = kmer.size();
+        if(length >= buckets_.size() || buckets_[length].patterns.empty())
+            return 0;
+        for(char base : kmer)
+            if(BaseIndex(base) < 0)
+                return 0;
+
+        const Bucket &bucket = buckets_[length];
+        int matches = 0;
+        const size_t blocks = (bucket.patterns.size() + 63) / 64;
+        for(size_t b = 0; b < blocks; ++b){
+            const uint64_t *block = &bucket.accepts[b * length * 4];
+            uint64_t candidates = ~uint64_t(0);
+            for(size_t i = 0; i < length && candidates != 0; ++i)
+                candidates &= block[i * 4 + BaseIndex(kmer[i])];
+            for(; candidates != 0; candidates &= candidates - 1){
+                const Pattern &pattern = patterns_[bucket.patterns[b * 64 + __builtin_ctzll(candidates)]];
+                for(const std::string &enzyme_acronym : pattern.enzyme_acronyms)
+                    visit(std::string_view(pattern.recognition_sequence), std::string_view(enzyme_acronym));
+                ++matches;
+            }
+        }
+        return matches;
+    }
+
+  private:
+    struct Pattern{
+        std::string recognition_sequence;          // As in the tree, cut marks included
+        std::vector<std::string> enzyme_acronyms;
+    };
+
+    // The patterns of one length, in blocks of 64.
+    // accepts[ (block * length + position) * 4 + base ] is the block's word for that base.
+    struct Bucket{
+        std::vector<uint32_t> patterns;            // Indices into patterns_
+        std::vector<uint64_t> accepts;
+    };
+
+    std::vector<Pattern> patterns_;
+    std::vector<Bucket> buckets_;                  // Indexed by pattern length
+};
+
+#endif
@@ -0,0 +1,82 @@
+// File's Title: key_prefix.h
+// Description: inline key prefixes that let AvlTree settle most comparisons
+// from the node header without reading the element itself.
+
+#ifndef KEY_PREFIX_H
+#define KEY_PREFIX_H
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Returned by a prefix compare( ) when only the full keys can tell.
+const int PREFIX_UNDECIDED = 2;
+
+// StringPrefix: an order-preserving summary of a string key in one word.
+// The first seven bytes sit big-endian in the high bits and min( length, 8 )
+// in the low byte, so comparing two prefixes as integers orders the strings
+// correctly unless both are at least eight bytes long and share their first seven.
+struct StringPrefix
+{
+    uint64_t bits;
+
+    static StringPrefix of( std::string_view key )
+    {
+        const size_t bytes = key.size( ) < 7 ? key.size( ) : 7;
+        uint64_t bits = 0;
+        for( size_t i = 0; i < bytes; ++i )
+            bits |= uint64_t( static_cast<unsigned char>( key[ i ] ) ) << ( 56 - 8 * i );
+        return StringPrefix{ bits | ( key.size( ) < 8 ? key.size( ) : 8 ) };
+    }
+
+    /**
+     * Return -1, 0 or 1 as a is less than, equal to or greater than b,
+     * or PREFIX_UNDECIDED if the full keys must be compared.
+     */
+    static int compare( StringPrefix a, StringPrefix b )
+    {
+        if( a.bits != b.bits )
+            return a.bits < b.bits ? -1 : 1;
+        return ( a.bits & 0xFF ) < 8 ? 0 : PREFIX_UNDECIDED;
+    }
+};
+
+// NoPrefix: for element types without one; every comparison reads the elements.
+struct NoPrefix
+{
+    static int compare( NoPrefix a, NoPrefix b )
+    {
+        return PREFIX_UNDECIDED;
+    }
+};
+
+// Return a 64-bit hash of a string key, for KeyPrefixTraits::hash( ).
+inline uint64_t HashKey( std::string_view key )
+{
+    return std::hash<std::string_view>{ }( key );
+}
+
+// KeyPrefixTraits<Comparable>::Prefix names the prefix AvlTree keeps inline in
+// its nodes, and of( x ) computes it for an element or a lookup key.
+// hash( x ) hashes an element or a lookup key, equally for the two when they
+// compare equal; only AvlTree's optional Bloom filter uses it.
+// Element types specialize it next to their definition.
+template <typename Comparable>
+struct KeyPrefixTraits
+{
+    typedef NoPrefix Prefix;
+
+    template <typename Key>
+    static Prefix of( const Key & x )
+    {
+        return Prefix{ };
+    }
+
+    template <typename Key>
+    static uint64_t hash( const Key & x )
+    {
+        return std::hash<Key>{ }( x );
+    }
+};
+
+#endif
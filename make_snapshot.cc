@@ -0,0 +1,41 @@
+// File's Title: make_snapshot.cc
+// Description: build an AVL tree from the database and write it out as a binary
+// snapshot that query_tree can load directly.
+
+#include "avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+#include "tree_snapshot.h"
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <snapshotfilename>" << endl;
+        return 0;
+    }
+    const string db_filename(argv[1]);
+    const string snapshot_filename(argv[2]);
+    MappedFile db_file(db_filename);
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+    vector<SequenceMap> sequence_maps;
+    ForEachRebaseRecord(db_file.contents(), [&sequence_maps](string_view enz_acro, string_view reco_seq){
+        sequence_maps.push_back(SequenceMap(reco_seq, enz_acro));
+    });
+    AvlTree<SequenceMap> a_tree;
+    a_tree.bulkLoad(make_move_iterator(sequence_maps.begin()), make_move_iterator(sequence_maps.end()));
+    if(!WriteTreeSnapshot(a_tree, snapshot_filename)){
+        cerr<<"Writing "<<snapshot_filename<<" failed!"<<endl;
+        exit(1);
+    }
+    cout<<"Wrote "<<a_tree.numberOfNodes()<<" nodes to "<<snapshot_filename<<endl;
+    return 0;
+}
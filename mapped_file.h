@@ -0,0 +1,76 @@
+// File's Title: mapped_file.h
+// Description: read-only memory mapping of a whole file.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+
+// MappedFile class
+//
+// CONSTRUCTION: with a filename; the whole file is mapped read-only
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool isOpen( )                 --> Return true if the file was mapped
+// std::string_view contents( )   --> Return the mapped bytes
+//
+// The views handed out stay valid until the MappedFile is destroyed.
+
+class MappedFile{
+  public:
+    explicit MappedFile(const std::string &filename) : data_(nullptr), size_(0), open_(false){
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return;
+        struct stat file_stat;
+        if(::fstat(fd, &file_stat) == 0){
+            size_ = static_cast<size_t>(file_stat.st_size);
+            if(size_ == 0)
+                open_ = true;
+            else{
+                void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mapping != MAP_FAILED){
+                    data_ = static_cast<const char *>(mapping);
+                    open_ = true;
+                    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile &rhs) = delete;
+    MappedFile &operator=(const MappedFile &rhs) = delete;
+
+    MappedFile(MappedFile &&rhs) : data_(rhs.data_), size_(rhs.size_), open_(rhs.open_){
+        rhs.data_ = nullptr;
+        rhs.size_ = 0;
+        rhs.open_ = false;
+    }
+
+    ~MappedFile(){
+        if(data_ != nullptr)
+            ::munmap(const_cast<char *>(data_), size_);
+    }
+
+    bool isOpen() const{
+        return open_;
+    }
+
+    std::string_view contents() const{
+        return std::string_view(data_, data_ == nullptr ? 0 : size_);
+    }
+
+  private:
+    const char *data_;
+    size_t size_;
+    bool open_;
+};
+
+#endif
@@ -0,0 +1,294 @@
+// File's Title: node_pool.h
+// Description: node allocator policies for AvlTree. NodePool carves nodes out of
+// contiguous chunks and gives whole chunks back at once; NewDeleteAllocator does one
+// new/delete per node.
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// NodePool class
+//
+// CONSTRUCTION: zero parameter
+//
+// ******************PUBLIC OPERATIONS*********************
+// Node * construct( args )  --> Build a node in pool storage
+// void destroy( p )         --> Destroy p and recycle its slot
+// void release( )           --> Free every chunk; nodes must already be destroyed
+// void adopt( rhs )         --> Take over the chunks of rhs, leaving it empty
+// void share( rhs )         --> Keep this pool's chunks alive for rhs too
+// ******************POLICY CONSTANTS**********************
+// BULK_RELEASE              --> true if release( ) frees all nodes at once
+//
+// Slots freed by destroy( ) are kept on a free list and reused before the
+// current chunk is bumped. Chunks grow geometrically up to MAX_CHUNK_NODES.
+// adopt( ) and share( ) let nodes move between trees: the chunks the pool has
+// so far become a group that every pool holding nodes in them references,
+// and a group is freed with the last such pool. Chunks added later are the
+// pool's own again.
+
+template <typename Node>
+class NodePool
+{
+  public:
+    static constexpr bool BULK_RELEASE = true;
+
+    NodePool( ) : chunks{ nullptr }, next{ nullptr }, last{ nullptr },
+                  freeList{ nullptr }, chunkNodes{ FIRST_CHUNK_NODES }
+    { }
+
+    NodePool( const NodePool & rhs ) = delete;
+    NodePool & operator=( const NodePool & rhs ) = delete;
+
+    NodePool( NodePool && rhs ) : NodePool{ }
+    {
+        swap( rhs );
+    }
+
+    NodePool & operator=( NodePool && rhs )
+    {
+        swap( rhs );
+        return *this;
+    }
+
+    ~NodePool( )
+    {
+        release( );
+    }
+
+    /**
+     * Construct a node from args in the next free slot.
+     */
+    template <typename... Args>
+    Node * construct( Args &&... args )
+    {
+        void *slot = allocate( );
+        try
+        {
+            return new ( slot ) Node{ std::forward<Args>( args )... };
+        }
+        catch( ... )
+        {
+            recycle( slot );
+            throw;
+        }
+    }
+
+    /**
+     * Destroy node p and put its slot on the free list.
+     */
+    void destroy( Node *p )
+    {
+        p->~Node( );
+        recycle( p );
+    }
+
+    /**
+     * Free every chunk, or let go of it if another pool shares it.
+     * Live nodes are not destroyed.
+     */
+    void release( )
+    {
+        freeChunks( chunks );
+        chunks = nullptr;
+        groups.clear( );
+        next = last = nullptr;
+        freeList = nullptr;
+        chunkNodes = FIRST_CHUNK_NODES;
+    }
+
+    /**
+     * Take over the chunks and free slots of rhs, which is left empty, so the
+     * nodes of rhs may be destroyed here and outlive rhs. The unused end of
+     * its newest chunk is given up.
+     */
+    void adopt( NodePool & rhs )
+    {
+        if( &rhs == this )
+            return;
+        rhs.retire( );
+        for( const std::shared_ptr<ChunkGroup> & group : rhs.groups )
+            addGroup( group );
+        if( rhs.freeList != nullptr )
+        {
+            FreeSlot *tail = rhs.freeList;
+            while( tail->next != nullptr )
+                tail = tail->next;
+            tail->next = freeList;
+            freeList = rhs.freeList;
+        }
+        rhs.groups.clear( );
+        rhs.release( );
+    }
+
+    /**
+     * Keep every chunk of this pool alive until rhs is released too, so rhs
+     * may hold nodes built here. Only this pool reuses their free slots.
+     */
+    void share( NodePool & rhs )
+    {
+        if( &rhs == this )
+            return;
+        retire( );
+        for( const std::shared_ptr<ChunkGroup> & group : groups )
+            rhs.addGroup( group );
+    }
+
+    void swap( NodePool & rhs )
+    {
+        std::swap( chunks, rhs.chunks );
+        groups.swap( rhs.groups );
+        std::swap( next, rhs.next );
+        std::swap( last, rhs.last );
+        std::swap( freeList, rhs.freeList );
+        std::swap( chunkNodes, rhs.chunkNodes );
+    }
+
+  private:
+    struct FreeSlot
+    {
+        FreeSlot *next;
+    };
+
+    struct Chunk
+    {
+        Chunk *next;
+    };
+
+    // Chunks retired from a pool's own list; freed with the last reference
+    struct ChunkGroup
+    {
+        Chunk *chunks;
+
+        ChunkGroup( Chunk *c ) : chunks{ c }
+        { }
+
+        ChunkGroup( const ChunkGroup & rhs ) = delete;
+        ChunkGroup & operator=( const ChunkGroup & rhs ) = delete;
+
+        ~ChunkGroup( )
+        {
+            freeChunks( chunks );
+        }
+    };
+
+    static constexpr size_t FIRST_CHUNK_NODES = 64;
+    static constexpr size_t MAX_CHUNK_NODES = 4096;
+
+    static constexpr size_t SLOT_ALIGN = alignof( Node ) > alignof( FreeSlot ) ? alignof( Node ) : alignof( FreeSlot );
+    static constexpr size_t SLOT_BYTES = sizeof( Node ) > sizeof( FreeSlot ) ? sizeof( Node ) : sizeof( FreeSlot );
+    static constexpr size_t SLOT_SIZE = ( SLOT_BYTES + SLOT_ALIGN - 1 ) / SLOT_ALIGN * SLOT_ALIGN;
+    static constexpr size_t HEADER_SIZE = ( sizeof( Chunk ) + SLOT_ALIGN - 1 ) / SLOT_ALIGN * SLOT_ALIGN;
+
+    Chunk *chunks;     // Chunks only this pool holds nodes in
+    std::vector<std::shared_ptr<ChunkGroup>> groups;
+    char *next;        // Next never-used slot in the newest chunk
+    char *last;        // End of the newest chunk
+    FreeSlot *freeList;
+    size_t chunkNodes;
+
+    static void freeChunks( Chunk *chunk )
+    {
+        while( chunk != nullptr )
+        {
+            Chunk *old = chunk;
+            chunk = chunk->next;
+            ::operator delete( old );
+        }
+    }
+
+    /**
+     * Move the pool's own chunks into a new group. The pool keeps bumping
+     * and reusing slots in them.
+     */
+    void retire( )
+    {
+        if( chunks == nullptr )
+            return;
+        groups.push_back( std::shared_ptr<ChunkGroup>( new ChunkGroup{ chunks } ) );
+        chunks = nullptr;
+    }
+
+    void addGroup( const std::shared_ptr<ChunkGroup> & group )
+    {
+        for( const std::shared_ptr<ChunkGroup> & held : groups )
+            if( held == group )
+                return;
+        groups.push_back( group );
+    }
+
+    void * allocate( )
+    {
+        if( freeList != nullptr )
+        {
+            FreeSlot *slot = freeList;
+            freeList = slot->next;
+            return slot;
+        }
+        if( next == last )
+            grow( );
+        void *slot = next;
+        next += SLOT_SIZE;
+        return slot;
+    }
+
+    void recycle( void *p )
+    {
+        FreeSlot *slot = static_cast<FreeSlot *>( p );
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+    void grow( )
+    {
+        char *raw = static_cast<char *>( ::operator new( HEADER_SIZE + chunkNodes * SLOT_SIZE ) );
+        Chunk *chunk = reinterpret_cast<Chunk *>( raw );
+        chunk->next = chunks;
+        chunks = chunk;
+        next = raw + HEADER_SIZE;
+        last = next + chunkNodes * SLOT_SIZE;
+        if( chunkNodes < MAX_CHUNK_NODES )
+            chunkNodes *= 2;
+    }
+};
+
+// NewDeleteAllocator class
+//
+// Plain one-allocation-per-node policy with the same interface as NodePool.
+
+template <typename Node>
+class NewDeleteAllocator
+{
+  public:
+    static constexpr bool BULK_RELEASE = false;
+
+    template <typename... Args>
+    Node * construct( Args &&... args )
+    {
+        return new Node{ std::forward<Args>( args )... };
+    }
+
+    void destroy( Node *p )
+    {
+        delete p;
+    }
+
+    void release( )
+    { }
+
+    void adopt( NewDeleteAllocator & rhs )
+    { }
+
+    void share( NewDeleteAllocator & rhs )
+    { }
+
+    void swap( NewDeleteAllocator & rhs )
+    { }
+};
+
+#endif
@@ -0,0 +1,184 @@
+// File's Title: packed_sequence.h
+// Description: recognition sequences packed four bits per character and compared as
+// two integers, and PackedSequenceMap, a SequenceMap that AvlTree orders by them.
+
+#ifndef PACKED_SEQUENCE_H
+#define PACKED_SEQUENCE_H
+
+#include "key_prefix.h"
+#include "sequence_map.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// PackedCodeTable: the 4-bit code of every character PackedSequence can pack.
+// entry[ c ] holds the code of c in the low nibble plus AMBIGUOUS for an IUPAC
+// ambiguity code, or is NO_CODE if c is not in the alphabet.
+struct PackedCodeTable{
+    static const uint8_t AMBIGUOUS = 0x10;
+    static const uint8_t NO_CODE = 0x20;
+
+    uint8_t entry[256];
+
+    constexpr PackedCodeTable() : entry{}{
+        const char alphabet[] = "'ABCDGHKMNRSTVWY";
+        for(int c = 0; c < 256; ++c)
+            entry[c] = NO_CODE;
+        for(int code = 0; code < 16; ++code){
+            const char c = alphabet[code];
+            const bool concrete = c == '\'' || c == 'A' || c == 'C' || c == 'G' || c == 'T';
+            entry[static_cast<unsigned char>(c)] = uint8_t(code | (concrete ? 0 : AMBIGUOUS));
+        }
+    }
+};
+
+inline constexpr PackedCodeTable PACKED_CODES{};
+
+// PackedSequence: a recognition sequence as 4-bit codes, ordered exactly like the strings.
+// The sixteen characters REBASE uses, ' A B C D G H K M N R S T V W Y, are coded 0 to 15
+// in ASCII order. The codes of up to 30 characters fill hi, then lo, from the top
+// nibble down, and the low byte of lo holds the length, so comparing (hi, lo) as
+// one 128-bit integer compares the characters in order and then the lengths. That
+// is the string order: when the codes tie, the shorter sequence is the longer one
+// cut short, since the free nibbles hold the code of ', which is 0.
+// A sequence longer than 30 characters or with any other character (lower case
+// included) is not packed; comparisons involving it fall back to the strings.
+struct PackedSequence{
+    uint64_t hi;
+    uint64_t lo;
+
+    static const size_t MAX_LENGTH = 30;
+    static const uint8_t NOT_PACKED = 0xFF;     // In the length byte
+
+    static PackedSequence of(std::string_view sequence){
+        const size_t length = sequence.size();
+        if(length > MAX_LENGTH)
+            return PackedSequence{0, NOT_PACKED};
+        // OR of every table entry, to spot a character outside the alphabet once at the end
+        uint8_t seen = 0;
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+        const size_t in_hi = length < 16 ? length : 16;
+        for(size_t i = 0; i < in_hi; ++i){
+            const uint8_t entry = PACKED_CODES.entry[static_cast<unsigned char>(sequence[i])];
+            seen |= entry;
+            hi = hi << 4 | (entry & 0xF);
+        }
+        for(size_t i = 16; i < length; ++i){
+            const uint8_t entry = PACKED_CODES.entry[static_cast<unsigned char>(sequence[i])];
+            seen |= entry;
+            lo = lo << 4 | (entry & 0xF);
+        }
+        if(seen & PackedCodeTable::NO_CODE)
+            return PackedSequence{0, NOT_PACKED};
+        // Left-align the codes; no shift is by 64, which would be undefined
+        const size_t in_lo = length - in_hi;
+        hi = in_hi == 0 ? 0 : hi << (4 * (16 - in_hi));
+        lo = in_lo == 0 ? 0 : lo << (4 * (16 - in_lo));
+        return PackedSequence{hi, lo | length};
+    }
+
+    size_t length() const{
+        return lo & 0xFF;
+    }
+
+    bool isPacked() const{
+        return length() != NOT_PACKED;
+    }
+
+    // Return the code of character i.
+    uint8_t code(size_t i) const{
+        return ((i < 16 ? hi : lo) >> (60 - 4 * (i % 16))) & 0xF;
+    }
+
+    // Return a mask with bit i set if character i is an IUPAC ambiguity code,
+    // i.e. not a cut mark or one of A, C, G and T; 0 if the sequence is not packed.
+    uint32_t degenerateMask() const{
+        static const char ALPHABET[] = "'ABCDGHKMNRSTVWY";
+        uint32_t mask = 0;
+        if(!isPacked())
+            return mask;
+        for(size_t i = 0; i < length(); ++i)
+            if(PACKED_CODES.entry[static_cast<unsigned char>(ALPHABET[code(i)])] & PackedCodeTable::AMBIGUOUS)
+                mask |= uint32_t(1) << i;
+        return mask;
+    }
+
+    // Return the sequence as a string; empty if it is not packed.
+    std::string unpack() const{
+        static const char ALPHABET[] = "'ABCDGHKMNRSTVWY";
+        std::string sequence;
+        if(!isPacked())
+            return sequence;
+        for(size_t i = 0; i < length(); ++i)
+            sequence += ALPHABET[code(i)];
+        return sequence;
+    }
+
+    // Return -1, 0 or 1 as a is less than, equal to or greater than b,
+    // or PREFIX_UNDECIDED if either is not packed and the strings must be compared.
+    static int compare(const PackedSequence &a, const PackedSequence &b){
+        // NOT_PACKED is the only length with its top bit set
+        if((a.lo | b.lo) & 0x80)
+            return PREFIX_UNDECIDED;
+        if(a.hi != b.hi)
+            return a.hi < b.hi ? -1 : 1;
+        if(a.lo != b.lo)
+            return a.lo < b.lo ? -1 : 1;
+        return 0;
+    }
+};
+
+// PackedSequenceMap: a SequenceMap that also keeps its recognition sequence packed.
+// AvlTree<PackedSequenceMap> stores the packed sequence inline in each node (see
+// the KeyPrefixTraits below) and packs a lookup key once per search, so every
+// comparison on the way down is two integer compares and the strings are read
+// only for sequences that do not pack. The order is the order of SequenceMap.
+class PackedSequenceMap : public SequenceMap{
+  public:
+    PackedSequenceMap(std::string_view a_rec_seq, std::string_view an_enz_acro)
+        : SequenceMap(a_rec_seq, an_enz_acro), packed_(PackedSequence::of(a_rec_seq)){ }
+
+    explicit PackedSequenceMap(const SequenceMap &x)
+        : SequenceMap(x), packed_(PackedSequence::of(x.getRecognitionSequence())){ }
+
+    bool operator<(const PackedSequenceMap &rhs) const{
+        const int order = PackedSequence::compare(packed_, rhs.packed_);
+        if(order != PREFIX_UNDECIDED)
+            return order < 0;
+        return getRecognitionSequence() < rhs.getRecognitionSequence();
+    }
+
+    // return the packed recognition sequence
+    const PackedSequence &getPackedSequence() const{
+        return packed_;
+    }
+
+  private:
+    PackedSequence packed_;
+};
+
+//AvlTree keeps the whole packed recognition sequence inline in each node
+template <>
+struct KeyPrefixTraits<PackedSequenceMap>{
+    typedef PackedSequence Prefix;
+
+    static Prefix of(const PackedSequenceMap &x){
+        return x.getPackedSequence();
+    }
+
+    static Prefix of(std::string_view x){
+        return PackedSequence::of(x);
+    }
+
+    static uint64_t hash(const PackedSequenceMap &x){
+        return HashKey(x.getRecognitionSequence());
+    }
+
+    static uint64_t hash(std::string_view x){
+        return HashKey(x);
+    }
+};
+
+#endif
@@ -0,0 +1,481 @@
+// File's Title: persistent_avl_tree.h
+// Description: a persistent AVL tree whose changes copy only the path they touch, so a
+// snapshot of it is O( 1 ) and stays readable, from any thread, while the tree changes.
+
+#ifndef PERSISTENT_AVL_TREE_H
+#define PERSISTENT_AVL_TREE_H
+
+#include "key_prefix.h"
+#include "sequence_map.h"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// PersistentAvlTree class
+//
+// CONSTRUCTION: zero parameter; copies are snapshots, made in O( 1 )
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; duplicates are merged
+// void remove( x )       --> Remove x; nothing is done if it is absent
+// bool contains( x )     --> Return true if x is present
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// PersistentAvlTree snapshot( ) --> Return the current version, in O( 1 )
+// uint64_t version( )    --> Return the number of changes behind this version
+// void forEach( visit )  --> Call visit( x ) on every item in sorted order
+// void findRecoSeq( x )  --> Find x and print its enzyme acronym
+// int numberOfNodes()    --> Return number of nodes, in O( 1 )
+// bool isValid( )        --> Return true if every AVL invariant holds, in O( n )
+// int find( x, recursive_call ) --> Return 1 if item is found, else 0
+//
+// Nodes never change once built. insert( ) and remove( ) build new copies of
+// the O( log n ) nodes on the path to x, rebalancing as they go, and share
+// every other subtree with the old version; each node counts the versions and
+// parents that hold it, atomically, and is freed with the last of them.
+// A snapshot is one more reference to the root. A PersistentAvlTree object is
+// not safe to change from two threads, or to change while it is being copied,
+// but its snapshots may be read, copied and dropped on any thread while the
+// tree they came from goes on changing.
+
+template <typename Comparable>
+class PersistentAvlTree
+{
+  public:
+    PersistentAvlTree( ) : root{ nullptr }, changes{ 0 }
+    { }
+
+    /**
+     * Snapshot: share rhs's nodes, in O( 1 ).
+     */
+    PersistentAvlTree( const PersistentAvlTree & rhs ) : root{ retain( rhs.root ) }, changes{ rhs.changes }
+    { }
+
+    PersistentAvlTree( PersistentAvlTree && rhs ) : root{ rhs.root }, changes{ rhs.changes }
+    {
+        rhs.root = nullptr;
+    }
+
+    ~PersistentAvlTree( )
+    {
+        release( root );
+    }
+
+    /**
+     * Snapshot.
+     */
+    PersistentAvlTree & operator=( const PersistentAvlTree & rhs )
+    {
+        const AvlNode *old = root;
+        root = retain( rhs.root );
+        changes = rhs.changes;
+        release( old );
+        return *this;
+    }
+
+    /**
+     * Move.
+     */
+    PersistentAvlTree & operator=( PersistentAvlTree && rhs )
+    {
+        std::swap( root, rhs.root );
+        std::swap( changes, rhs.changes );
+        return *this;
+    }
+
+    /**
+     * Return the current version of the tree, which later changes leave alone.
+     */
+    PersistentAvlTree snapshot( ) const
+    {
+        return *this;
+    }
+
+    /**
+     * Return the number of insert( ) and remove( ) calls, and makeEmpty( ) calls,
+     * that changed the tree on the way to this version.
+     */
+    uint64_t version( ) const
+    {
+        return changes;
+    }
+
+    /**
+     * Returns true if x is found in the tree.
+     */
+    bool contains( const Comparable & x ) const
+    {
+        return findNode( x ) != nullptr;
+    }
+
+    /**
+     * Test if the tree is logically empty.
+     * Return true if empty, false otherwise.
+     */
+    bool isEmpty( ) const
+    {
+        return root == nullptr;
+    }
+
+    /**
+     * Make the tree logically empty. Snapshots keep their items.
+     */
+    void makeEmpty( )
+    {
+        if( root == nullptr )
+            return;
+        release( root );
+        root = nullptr;
+        ++changes;
+    }
+
+    /**
+     * Insert x into the tree; duplicates will be merged.
+     * Snapshots taken before do not see it.
+     */
+    void insert( const Comparable & x )
+    {
+        const AvlNode *old = root;
+        root = insert( x, PrefixTraits::of( x ), root );
+        release( old );
+        ++changes;
+    }
+
+    /**
+     * Remove x from the tree. Nothing is done if x is not found.
+     * Snapshots taken before keep it.
+     */
+    void remove( const Comparable & x )
+    {
+        if( !contains( x ) )
+            return;
+        const AvlNode *old = root;
+        root = remove( x, PrefixTraits::of( x ), root );
+        release( old );
+        ++changes;
+    }
+
+    /**
+     * Call visit( x ) on every item in sorted order.
+     */
+    template <typename Visitor>
+    void forEach( Visitor visit ) const
+    {
+        vector<const AvlNode *> path;
+        const AvlNode *t = root;
+        while( t != nullptr || !path.empty( ) )
+        {
+            if( t != nullptr )
+            {
+                path.push_back( t );
+                t = t->left;
+            }
+            else
+            {
+                t = path.back( );
+                path.pop_back( );
+                visit( t->element );
+                t = t->right;
+            }
+        }
+    }
+
+    /**
+     * Find the item in the tree and print the associated enzyme acronym.
+     * Else print "Not Found"
+     */
+    void findRecoSeq( std::string_view x ) const
+    {
+        const AvlNode *t = findNode( x );
+        if( t != nullptr )
+            t->element.printEnzymeAcronym( );
+        else
+            cout<<"Not Found"<<endl;
+    }
+
+    /**
+     * Return the number of nodes in the tree
+     */
+    int numberOfNodes( ) const
+    {
+        return size( root );
+    }
+
+    /**
+     * Return true if the version is a valid AVL tree: the items are in order,
+     * each node's prefix is the prefix of its item, every stored height and
+     * size is exact, the two subtrees of every node differ in height by at
+     * most one, and every node is held at least once. O( n ); for tests.
+     */
+    bool isValid( ) const
+    {
+        return checkSubtree( root, nullptr, nullptr ) != INVALID_SUBTREE;
+    }
+
+    /**
+     * Return 1 if item is found, else 0
+     * Count one recursive call per node visited, as AvlTree::find( ) does.
+     */
+    int find( std::string_view x, int &find_recursive_call ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        const AvlNode *t = root;
+        while( true )
+        {
+            ++find_recursive_call;
+            if( t == nullptr )
+                return 0;
+            int order = compare( x, xp, t );
+            if( order == 0 )
+                return 1;
+            t = order < 0 ? t->left : t->right;
+        }
+    }
+
+  private:
+    typedef KeyPrefixTraits<Comparable> PrefixTraits;
+    typedef typename PrefixTraits::Prefix Prefix;
+
+    // An immutable node. references counts the parents and tree versions
+    // holding it; the search fields come first, as in AvlTree.
+    struct AvlNode
+    {
+        const AvlNode *left;
+        const AvlNode *right;
+        Prefix         prefix;
+        signed char    height;
+        int            size;
+        mutable std::atomic<int> references;
+        Comparable     element;
+
+        AvlNode( const AvlNode *lt, Comparable && ele, const AvlNode *rt )
+          : left{ lt }, right{ rt }, prefix( PrefixTraits::of( ele ) ),
+            height( 1 + ( heightOf( lt ) > heightOf( rt ) ? heightOf( lt ) : heightOf( rt ) ) ),
+            size{ 1 + PersistentAvlTree::size( lt ) + PersistentAvlTree::size( rt ) },
+            references{ 1 }, element{ std::move( ele ) } { }
+    };
+
+    const AvlNode *root;
+    uint64_t changes;
+
+    static const int ALLOWED_IMBALANCE = 1;
+    static const int INVALID_SUBTREE = -2;
+
+    static int heightOf( const AvlNode *t )
+    {
+        return t == nullptr ? -1 : t->height;
+    }
+
+    static int size( const AvlNode *t )
+    {
+        return t == nullptr ? 0 : t->size;
+    }
+
+    /**
+     * Internal method to check the subtree t for isValid( ). The items of t
+     * must be greater than the item of lo and less than the item of hi,
+     * where given. Return the height of t, or INVALID_SUBTREE.
+     */
+    static int checkSubtree( const AvlNode *t, const AvlNode *lo, const AvlNode *hi )
+    {
+        if( t == nullptr )
+            return -1;
+        if( t->references.load( std::memory_order_relaxed ) < 1 )
+            return INVALID_SUBTREE;
+        if( ( lo != nullptr && !( lo->element < t->element ) ) || ( hi != nullptr && !( t->element < hi->element ) ) )
+            return INVALID_SUBTREE;
+        int prefixOrder = Prefix::compare( t->prefix, PrefixTraits::of( t->element ) );
+        if( prefixOrder != 0 && prefixOrder != PREFIX_UNDECIDED )
+            return INVALID_SUBTREE;
+        int leftHeight = checkSubtree( t->left, lo, t );
+        int rightHeight = checkSubtree( t->right, t, hi );
+        if( leftHeight == INVALID_SUBTREE || rightHeight == INVALID_SUBTREE )
+            return INVALID_SUBTREE;
+        if( leftHeight - rightHeight > ALLOWED_IMBALANCE || rightHeight - leftHeight > ALLOWED_IMBALANCE )
+            return INVALID_SUBTREE;
+        if( t->height != ( leftHeight > rightHeight ? leftHeight : rightHeight ) + 1
+            || t->size != 1 + size( t->left ) + size( t->right ) )
+            return INVALID_SUBTREE;
+        return t->height;
+    }
+
+    /**
+     * Take one more reference to t, unless t is nullptr. Return t.
+     */
+    static const AvlNode * retain( const AvlNode *t )
+    {
+        if( t != nullptr )
+            t->references.fetch_add( 1, std::memory_order_relaxed );
+        return t;
+    }
+
+    /**
+     * Drop a reference to t; free it, and drop its references to its
+     * children, if it was the last. Reading a node happens before the
+     * release that lets another thread free it.
+     */
+    static void release( const AvlNode *t )
+    {
+        while( t != nullptr && t->references.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        {
+            const AvlNode *right = t->right;
+            release( t->left );
+            delete t;
+            t = right;
+        }
+    }
+
+    /**
+     * Return the element of t, which the caller holds a reference to and is
+     * about to drop: moved out if that is the only reference, since no one
+     * else can reach t then, else copied.
+     */
+    static Comparable take( const AvlNode *t )
+    {
+        if( t->references.load( std::memory_order_acquire ) == 1 )
+            return std::move( const_cast<AvlNode *>( t )->element );
+        return t->element;
+    }
+
+    /**
+     * Build a node over l and r, which hand over a reference each.
+     */
+    static const AvlNode * make( const AvlNode *l, Comparable && x, const AvlNode *r )
+    {
+        return new AvlNode{ l, std::move( x ), r };
+    }
+
+    /**
+     * Build a balanced subtree of l, x and r, whose heights differ by at most
+     * ALLOWED_IMBALANCE + 1, with a single or double rotation if needed.
+     * l and r hand over a reference each. A node rotated out of the way is
+     * rebuilt, not changed, since another version may hold it; its element
+     * is moved only if nothing else does.
+     */
+    static const AvlNode * balanced( const AvlNode *l, Comparable && x, const AvlNode *r )
+    {
+        const AvlNode *result;
+        if( heightOf( l ) - heightOf( r ) > ALLOWED_IMBALANCE )
+        {
+            if( heightOf( l->left ) >= heightOf( l->right ) )
+                result = make( retain( l->left ), take( l ),
+                               make( retain( l->right ), std::move( x ), r ) );
+            else
+            {
+                const AvlNode *lr = l->right;
+                result = make( make( retain( l->left ), take( l ), retain( lr->left ) ),
+                               Comparable{ lr->element },
+                               make( retain( lr->right ), std::move( x ), r ) );
+            }
+            release( l );
+            return result;
+        }
+        if( heightOf( r ) - heightOf( l ) > ALLOWED_IMBALANCE )
+        {
+            if( heightOf( r->right ) >= heightOf( r->left ) )
+                result = make( make( l, std::move( x ), retain( r->left ) ),
+                               take( r ), retain( r->right ) );
+            else
+            {
+                const AvlNode *rl = r->left;
+                result = make( make( l, std::move( x ), retain( rl->left ) ),
+                               Comparable{ rl->element },
+                               make( retain( rl->right ), take( r ), retain( r->right ) ) );
+            }
+            release( r );
+            return result;
+        }
+        return make( l, std::move( x ), r );
+    }
+
+    /**
+     * Three-way comparison of key x against the element in node t.
+     * xp is the prefix of x; the element is read only when the prefixes tie.
+     */
+    template <typename Key>
+    static int compare( const Key & x, const Prefix & xp, const AvlNode *t )
+    {
+        int order = Prefix::compare( xp, t->prefix );
+        if( order != PREFIX_UNDECIDED )
+            return order;
+        if( x < t->element )
+            return -1;
+        if( t->element < x )
+            return 1;
+        return 0;
+    }
+
+    template <typename Key>
+    const AvlNode * findNode( const Key & x ) const
+    {
+        const Prefix xp = PrefixTraits::of( x );
+        const AvlNode *t = root;
+        while( t != nullptr )
+        {
+            int order = compare( x, xp, t );
+            if( order == 0 )
+                return t;
+            t = order < 0 ? t->left : t->right;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Internal method to insert into a subtree, which is only read.
+     * Return a new subtree with x added, sharing what x does not touch;
+     * the caller owns its one reference.
+     * In case of duplicates, call Merge() on a copy of the element.
+     */
+    static const AvlNode * insert( const Comparable & x, const Prefix & xp, const AvlNode *t )
+    {
+        if( t == nullptr )
+            return make( nullptr, Comparable{ x }, nullptr );
+        int order = compare( x, xp, t );
+        if( order < 0 )
+            return balanced( insert( x, xp, t->left ), Comparable{ t->element }, retain( t->right ) );
+        if( order > 0 )
+            return balanced( retain( t->left ), Comparable{ t->element }, insert( x, xp, t->right ) );
+        Comparable merged{ t->element };
+        merged.Merge( x );
+        return make( retain( t->left ), std::move( merged ), retain( t->right ) );
+    }
+
+    /**
+     * Internal method to remove x, which must be present, from a subtree
+     * that is only read. Return the new subtree, as insert( ) does.
+     * A node with two children is replaced by a copy of the smallest item
+     * of its right subtree.
+     */
+    static const AvlNode * remove( const Comparable & x, const Prefix & xp, const AvlNode *t )
+    {
+        int order = compare( x, xp, t );
+        if( order < 0 )
+            return balanced( remove( x, xp, t->left ), Comparable{ t->element }, retain( t->right ) );
+        if( order > 0 )
+            return balanced( retain( t->left ), Comparable{ t->element }, remove( x, xp, t->right ) );
+        if( t->left == nullptr )
+            return retain( t->right );
+        if( t->right == nullptr )
+            return retain( t->left );
+        const AvlNode *smallest = t->right;
+        while( smallest->left != nullptr )
+            smallest = smallest->left;
+        return balanced( retain( t->left ), Comparable{ smallest->element }, removeMin( t->right ) );
+    }
+
+    /**
+     * Internal method to remove the smallest item of a nonempty subtree.
+     */
+    static const AvlNode * removeMin( const AvlNode *t )
+    {
+        if( t->left == nullptr )
+            return retain( t->right );
+        return balanced( removeMin( t->left ), Comparable{ t->element }, retain( t->right ) );
+    }
+};
+
+#endif
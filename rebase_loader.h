@@ -0,0 +1,58 @@
+// File's Title: rebase_loader.h
+// Description: tokenizes the records of a memory-mapped REBASE database in place,
+// handing out string_views into the mapping instead of copying each field.
+
+#ifndef REBASE_LOADER_H
+#define REBASE_LOADER_H
+
+#include "mapped_file.h"
+
+#include <cstring>
+#include <string_view>
+
+// @line: one line of a REBASE file, without its newline.
+// Return true if the line has the shape of a record, Enzyme/seq/.../seq//:
+// no blanks, a non-empty enzyme name before the first '/', and a closing "//".
+// Banner, copyright and blank lines never match, so they are skipped
+// wherever they appear instead of counting a fixed number of header lines.
+inline bool IsRebaseRecord(std::string_view line){
+    if(line.size() < 4 || line.front() == '/' || line.substr(line.size() - 2) != "//")
+        return false;
+    for(char c : line)
+        if(c == ' ' || c == '\t')
+            return false;
+    return true;
+}
+
+// @db: the contents of a REBASE file.
+// @record: called as record(enzyme_acronym, recognition_sequence) for every
+//  recognition sequence of every record, in file order. Both arguments are
+//  views into db.
+template <typename Callback>
+void ForEachRebaseRecord(std::string_view db, Callback record){
+    size_t line_start = 0;
+    while(line_start < db.size()){
+        const char *newline = static_cast<const char *>(
+            std::memchr(db.data() + line_start, '\n', db.size() - line_start));
+        size_t line_end = newline == nullptr ? db.size() : newline - db.data();
+        std::string_view line = db.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        while(!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.remove_suffix(1);
+        if(!IsRebaseRecord(line))
+            continue;
+
+        size_t field_end = line.find('/');
+        std::string_view enz_acro = line.substr(0, field_end);
+        // Fields run up to the empty one that the closing "//" leaves
+        for(size_t field_start = field_end + 1; ; field_start = field_end + 1){
+            field_end = line.find('/', field_start);
+            if(field_end == field_start || field_end == std::string_view::npos)
+                break;
+            record(enz_acro, line.substr(field_start, field_end - field_start));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+// File's Title: reverse_complement.h
+// Description: reverse complement of IUPAC sequences, sixteen characters at a time with
+// SSSE3 where the CPU has it, and the canonical form of a sequence, the same on both strands.
+
+#ifndef REVERSE_COMPLEMENT_H
+#define REVERSE_COMPLEMENT_H
+
+#include "iupac_index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REVERSE_COMPLEMENT_SSSE3 1
+#endif
+
+// ComplementTable: IupacComplement() of every character, so entry[ c ] is the
+// character that pairs with c. Cut marks and other characters map to themselves.
+struct ComplementTable{
+    char entry[256];
+
+    constexpr ComplementTable() : entry{}{
+        for(int c = 0; c < 256; ++c)
+            entry[c] = IupacComplement(char(c));
+    }
+};
+
+inline constexpr ComplementTable COMPLEMENTS{};
+
+// @sequence: length characters to read.
+// @out: length characters to write; must not overlap sequence.
+// Write the reverse complement of sequence to out, one character at a time.
+inline void ReverseComplementScalar(const char *sequence, size_t length, char *out){
+    for(size_t i = 0; i < length; ++i)
+        out[length - 1 - i] = COMPLEMENTS.entry[static_cast<unsigned char>(sequence[i])];
+}
+
+#ifdef REVERSE_COMPLEMENT_SSSE3
+// As ReverseComplementScalar(), sixteen characters at a time. Only 0x40 - 0x7F
+// hold letters, and the complement keeps the case, so a character there is
+// complemented by looking its low nibble up (pshufb) in the upper-case row it
+// falls in, 0x40 or 0x50, and putting its case bit back; any other character
+// is kept. A last pshufb reverses the block.
+// Callers must check that the CPU supports SSSE3.
+__attribute__((target("ssse3")))
+inline void ReverseComplementSsse3(const char *sequence, size_t length, char *out){
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i row_40 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(COMPLEMENTS.entry + 0x40));
+    const __m128i row_50 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(COMPLEMENTS.entry + 0x50));
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    const __m128i row_bit = _mm_set1_epi8(0x10);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i range_bits = _mm_set1_epi8(char(0xC0));
+    const __m128i letter_range = _mm_set1_epi8(0x40);
+
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16){
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sequence + i));
+        const __m128i column = _mm_and_si128(block, low_nibble);
+        const __m128i in_50 = _mm_cmpeq_epi8(_mm_and_si128(block, row_bit), row_bit);
+        const __m128i upper = _mm_or_si128(_mm_andnot_si128(in_50, _mm_shuffle_epi8(row_40, column)),
+                                           _mm_and_si128(in_50, _mm_shuffle_epi8(row_50, column)));
+        const __m128i complement = _mm_or_si128(upper, _mm_and_si128(block, case_bit));
+        const __m128i in_range = _mm_cmpeq_epi8(_mm_and_si128(block, range_bits), letter_range);
+        const __m128i result = _mm_or_si128(_mm_andnot_si128(in_range, block), _mm_and_si128(in_range, complement));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + length - 16 - i), _mm_shuffle_epi8(result, reverse));
+    }
+    // The last characters go to the front of out
+    ReverseComplementScalar(sequence + i, length - i, out);
+}
+#endif
+
+// Return true if ReverseComplement() runs the vector kernel on this CPU.
+inline bool ReverseComplementIsVectorized(){
+#ifdef REVERSE_COMPLEMENT_SSSE3
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+#else
+    return false;
+#endif
+}
+
+// @sequence: length characters to read.
+// @out: length characters to write; must not overlap sequence.
+// Write the reverse complement of sequence to out, with the fastest kernel the CPU runs.
+inline void ReverseComplement(const char *sequence, size_t length, char *out){
+#ifdef REVERSE_COMPLEMENT_SSSE3
+    if(ReverseComplementIsVectorized()){
+        ReverseComplementSsse3(sequence, length, out);
+        return;
+    }
+#endif
+    ReverseComplementScalar(sequence, length, out);
+}
+
+// Return the reverse complement of sequence: the sequence as read on the other strand.
+// Cut marks keep their place between the same two bases.
+inline std::string ReverseComplement(std::string_view sequence){
+    std::string reverse(sequence.size(), '\0');
+    ReverseComplement(sequence.data(), sequence.size(), &reverse[0]);
+    return reverse;
+}
+
+// A sequence in canonical form: the lesser of it and its reverse complement,
+// which is the same whichever strand the sequence was read from.
+struct CanonicalKey{
+    std::string sequence;
+    char strand;                // '+' if sequence is the input, '-' if its reverse complement
+};
+
+// Return the canonical form of sequence. A sequence that is its own reverse
+// complement is its canonical form, on strand '+'.
+inline CanonicalKey Canonicalize(std::string_view sequence){
+    std::string reverse = ReverseComplement(sequence);
+    if(std::string_view(reverse) < sequence)
+        return CanonicalKey{std::move(reverse), '-'};
+    return CanonicalKey{std::string(sequence), '+'};
+}
+
+#endif
@@ -0,0 +1,146 @@
+// File's Title: scan_genome.cc
+// Description: build an AVL tree from the database, compile its recognition sequences
+// into a SiteScanner and report every restriction site in a FASTA file, one line per
+// (record, position, enzyme, strand), with the scanning throughput on stderr.
+// With a thread count, the records are cut into chunks scanned in parallel; the
+// output is the same. With --check in place of the FASTA file, scan built-in
+// sequences both ways and check the sites found.
+
+#include "avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+#include "site_scanner.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &a_file){
+    if(!a_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @db_filename: an input database filename.
+// @a_tree: an input tree of the type TreeType. It is assumed to be empty.
+// Create an AVL tree.
+template <typename TreeType>
+void ConstructTree(const string &db_filename, TreeType &a_tree){
+    MappedFile db_file(db_filename);
+    CheckFile(db_file);
+    ForEachRebaseRecord(db_file.contents(), [&a_tree](string_view enz_acro, string_view reco_seq){
+        a_tree.insert(SequenceMap(reco_seq, enz_acro));
+    });
+}
+
+// One built-in check: a record and the one site an enzyme must have in it.
+struct SiteCase{
+    const char *fasta;
+    const char *enzyme_acronym;
+    uint64_t position;
+    char strand;
+};
+
+// @scanner: the compiled REBASE enzyme set.
+// Scan each case serially and on two threads in 8-byte chunks, so its site
+// crosses a chunk border, and check that the enzyme is found exactly once,
+// where and on the strand expected.
+// AarI, MboII, BfuAI and BveI are listed in both orientations, whose sites
+// are each other's reverse complement, and SgeI in two that strip to the same
+// site; each site must still be found once.
+// Return the number of failed checks.
+int CheckSites(const SiteScanner &scanner){
+    const SiteCase cases[] = {
+        {">t\nTTTTTTCACCTGCTTTTTTTTTTTT\n", "AarI", 6, '+'},
+        {">t\nTTTTTTGCAGGTGTTTTTTTTTTTT\n", "AarI", 6, '-'},
+        {">t\nTTTTTTTGAAGATTTTTTTTTTTTTTT\n", "MboII", 7, '+'},
+        {">t\nTTTTTTTTCTTCTTTTTTTTTTTTTTT\n", "MboII", 7, '-'},
+        {">t\nTTTTTACCTGCTTTTTTTT\n", "BfuAI", 5, '+'},
+        {">t\nTTTTTACCTGCTTTTTTTT\n", "BveI", 5, '+'},
+        {">t\nTTTTTCAAGTTTTTTTTTT\n", "SgeI", 5, '+'},
+        {">t\nTTTTTGAATTCTTTTTTTT\n", "EcoRI", 5, '+'},
+    };
+    ThreadPool pool(2);
+    int failures = 0;
+    for(const SiteCase &site_case : cases){
+        for(int parallel = 0; parallel < 2; ++parallel){
+            vector<SiteHit> hits;
+            auto keep_hit = [&hits, &site_case](string_view, const SiteHit &hit){
+                if(hit.enzyme_acronym == site_case.enzyme_acronym)
+                    hits.push_back(hit);
+            };
+            if(parallel)
+                ScanFastaParallel(scanner, site_case.fasta, pool, keep_hit, 8);
+            else
+                ScanFasta(scanner, site_case.fasta, keep_hit);
+            if(hits.size() != 1 || hits[0].position != site_case.position || hits[0].strand != site_case.strand){
+                cout<<"check: "<<site_case.enzyme_acronym<<(parallel ? " parallel" : " serial")<<": "
+                    <<hits.size()<<" hits"<<endl;
+                ++failures;
+            }
+        }
+    }
+    cout<<"check: "<<sizeof(cases) / sizeof(cases[0])<<" cases, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 3 && argc != 4) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <fastafilename> [threads]" << endl;
+        cout << "Without threads, the scan runs serially on the calling thread." << endl;
+        cout << "With --check for the FASTA file, check the sites of built-in sequences." << endl;
+        return 0;
+    }
+    const string db_filename(argv[1]);
+    const string fasta_filename(argv[2]);
+    const size_t threads = argc == 4 ? strtoull(argv[3], nullptr, 10) : 0;
+    AvlTree<SequenceMap> a_tree;
+    ConstructTree(db_filename, a_tree);
+    const SiteScanner scanner(a_tree);
+    cerr<<scanner.numberOfPatterns()<<" site patterns in "<<scanner.numberOfWords()<<" words"<<endl;
+    if(fasta_filename == "--check"){
+        const int failures = CheckSites(scanner);
+        cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    MappedFile fasta_file(fasta_filename);
+    CheckFile(fasta_file);
+    size_t hits = 0;
+    const auto start = chrono::steady_clock::now();
+    auto print_hit = [&hits](string_view record_name, const SiteHit &hit){
+        printf("%.*s\t%llu\t%.*s\t%c\n", int(record_name.size()), record_name.data(),
+               static_cast<unsigned long long>(hit.position),
+               int(hit.enzyme_acronym.size()), hit.enzyme_acronym.data(), hit.strand);
+        ++hits;
+    };
+    if(threads == 0){
+        ScanFasta(scanner, fasta_file.contents(), print_hit);
+    }
+    else{
+        ThreadPool pool(threads);
+        ScanFastaParallel(scanner, fasta_file.contents(), pool, print_hit);
+    }
+    fflush(stdout);
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr<<hits<<" sites in "<<fasta_file.contents().size()/1e6<<" MB, "
+        <<fasta_file.contents().size()/1e6/seconds<<" MB/s";
+    if(threads > 0)
+        cerr<<" on "<<threads<<" threads";
+    cerr<<endl;
+    return 0;
+}
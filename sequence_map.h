@@ -6,9 +6,12 @@
 #ifndef SEQUENCE_MAP_H
 #define SEQUENCE_MAP_H
 
+#include "acronym_table.h"
+#include "key_prefix.h"
+
 #include <iostream>
 #include <string>
-#include <vector>
+#include <string_view>
 
 class SequenceMap{
   public:
@@ -31,9 +34,9 @@ class SequenceMap{
     
     
     //Two parameters constructor
-    SequenceMap(const std::string &a_rec_seq, const std::string &an_enz_acro){
-        recognition_sequence_ = a_rec_seq;
-        enzyme_acronym_.push_back(an_enz_acro);
+    SequenceMap(std::string_view a_rec_seq, std::string_view an_enz_acro)
+        : recognition_sequence_(a_rec_seq){
+        enzyme_acronym_.push_back(AcronymTable::Global().intern(an_enz_acro));
     }
     
     //String comparison between two recognition sequences
@@ -42,12 +45,22 @@ class SequenceMap{
         return (recognition_sequence_ < rhs.recognition_sequence_);
     }
     
+    //Heterogeneous comparisons against a bare recognition sequence (like std::less<>),
+    //so a lookup by key compares in place instead of building a SequenceMap or a string
+    friend bool operator<(const SequenceMap &lhs, std::string_view rhs) {
+        return std::string_view(lhs.recognition_sequence_) < rhs;
+    }
+    
+    friend bool operator<(std::string_view lhs, const SequenceMap &rhs) {
+        return lhs < std::string_view(rhs.recognition_sequence_);
+    }
+    
     //Overload operator <<
     //Allow user to print the contents of a sequence_map object
     friend std::ostream &operator<<(std::ostream &out, const SequenceMap &seq_map){
         out << seq_map.recognition_sequence_ << " ";
         for(size_t i = 0; i < seq_map.enzyme_acronym_.size(); ++i)
-            out << seq_map.enzyme_acronym_[i] << " ";
+            out << seq_map.getEnzymeAcronym(i) << " ";
         return out;
     }
 
@@ -55,26 +68,58 @@ class SequenceMap{
     //Merges the other_sequence.enzyme_acronym_ with the object’s enzyme_acronym_
     //Pre-condition: the object's recognition_seuqnece_ and the other_sequence's recognition_ sequence_ are equal
     //Post-condition: the other_sequence.enzyme_acronym_ is appended to the object’s enzyme_acronym_
+    //Only the IDs are copied, and only a third acronym or more allocates
     void Merge(const SequenceMap &other_sequence){
-        for(size_t i = 0; i < other_sequence.enzyme_acronym_.size(); ++i)
-            enzyme_acronym_.push_back(other_sequence.enzyme_acronym_[i]);
+        enzyme_acronym_.append(other_sequence.enzyme_acronym_);
     }
     
     // return recognition_sequence_
-    std::string getRecognitionSequence(){
+    const std::string &getRecognitionSequence() const{
         return recognition_sequence_;
     }
     
+    // return the number of enzyme acronyms
+    size_t getEnzymeCount() const{
+        return enzyme_acronym_.size();
+    }
+    
+    // return the i-th enzyme acronym; it stays valid for the rest of the program
+    std::string_view getEnzymeAcronym(size_t i) const{
+        return AcronymTable::Global().name(enzyme_acronym_[i]);
+    }
+    
     // Print the associated enzyme acronym
-    void printEnzymeAcronym(){
+    void printEnzymeAcronym() const{
         for(size_t i = 0; i < enzyme_acronym_.size(); ++i)
-            std::cout<<enzyme_acronym_[i]<<" ";
+            std::cout<<getEnzymeAcronym(i)<<" ";
         std::cout<<std::endl;
     }
 
   private:
     std::string recognition_sequence_;
-    std::vector<std::string> enzyme_acronym_;
+    AcronymIdList enzyme_acronym_;          // IDs in AcronymTable::Global()
+};
+
+//AvlTree keeps the first bytes of the recognition sequence inline in each node
+template <>
+struct KeyPrefixTraits<SequenceMap>{
+    typedef StringPrefix Prefix;
+    
+    static Prefix of(const SequenceMap &x){
+        return StringPrefix::of(x.getRecognitionSequence());
+    }
+    
+    static Prefix of(std::string_view x){
+        return StringPrefix::of(x);
+    }
+    
+    static uint64_t hash(const SequenceMap &x){
+        return HashKey(x.getRecognitionSequence());
+    }
+    
+    static uint64_t hash(std::string_view x){
+        return HashKey(x);
+    }
 };
 	
 #endif
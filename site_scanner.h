@@ -0,0 +1,391 @@
+// File's Title: site_scanner.h
+// Description: finds every restriction site of an enzyme set in long DNA sequences,
+// both strands and IUPAC degeneracy included, with a multi-pattern Shift-And automaton.
+
+#ifndef SITE_SCANNER_H
+#define SITE_SCANNER_H
+
+#include "dsexceptions.h"
+#include "iupac_index.h"
+#include "sequence_map.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// One restriction site found in a sequence.
+struct SiteHit{
+    uint64_t position;                      // 0-based offset of the site's first base in its record
+    uint32_t length;                        // Bases the site spans
+    std::string_view recognition_sequence;  // As in the tree, cut marks included
+    std::string_view enzyme_acronym;
+    char strand;                            // '+', or '-' if the site reads on the reverse strand
+};
+
+// SiteScanner class
+//
+// CONSTRUCTION: from any tree of SequenceMap with forEach( )
+//
+// ******************PUBLIC OPERATIONS*********************
+// size_t numberOfPatterns( )        --> Return the number of distinct site patterns
+// size_t numberOfWords( )           --> Return the automaton's state size in 64-bit words
+// size_t maxPatternLength( )        --> Return the length of the longest site
+// bool isBase( c )                  --> Return false for the line breaks and blanks scan( ) skips
+// ScanState newState( )             --> Return the state for the start of a sequence
+// void scan( text, state, visit )   --> Feed text to the automaton; visit( hit ) per site
+//
+// A site is the recognition sequence without its cut marks and without the runs
+// of N at either end, which only place the cut. Each site is searched for as
+// read on the forward strand and, unless it is its own reverse complement, as
+// read on the reverse strand. Some enzymes are listed with their site in both
+// orientations (AarI as CACCTGCNNNN'NNNN and 'NNNNNNNNGCAGGTG); each finds the
+// other's sites on the reverse strand, so only the orientation whose site sorts
+// first is kept. When both strip to the same site (SgeI's CNNG) it is kept once.
+// Every site of an enzyme is thus reported once.
+//
+// Shift-And: bit i of a pattern is set while the last i + 1 bases read match
+// the first i + 1 positions of the pattern, so a whole set of patterns advances
+// by one shift, one OR and one AND per base. The patterns are packed into 64-bit
+// words without straddling a boundary, which keeps every word independent, and
+// the words are processed two at a time as 128-bit vectors. An IUPAC position
+// simply sets its bit in the accept mask of every base it stands for.
+//
+// Errors:
+// Throws IllegalArgumentException if a site is longer than 64 bases.
+class SiteScanner{
+  public:
+    // Two state words, shifted and masked together
+    typedef uint64_t Block __attribute__((vector_size(16)));
+
+    // The automaton's position in one sequence; keep one per sequence scanned.
+    struct ScanState{
+        std::vector<Block> active;
+        uint64_t position;
+    };
+
+    template <typename TreeType>
+    explicit SiteScanner(const TreeType &a_tree){
+        // Every (enzyme acronym, site pattern) pair of the tree
+        std::set<std::pair<std::string, std::string>> enzyme_patterns;
+        a_tree.forEach([&enzyme_patterns](const SequenceMap &x){
+            const std::string pattern = StripFlanks(StripCutMarks(x.getRecognitionSequence()));
+            for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+                enzyme_patterns.emplace(std::string(x.getEnzymeAcronym(i)), pattern);
+        });
+        // Every distinct site pattern, with the sites of the tree that use it
+        std::map<std::string, std::vector<Site>> patterns;
+        std::set<std::pair<std::string, std::string>> kept;
+        a_tree.forEach([&patterns, &enzyme_patterns, &kept](const SequenceMap &x){
+            const std::string pattern = StripFlanks(StripCutMarks(x.getRecognitionSequence()));
+            if(pattern.empty())
+                return;
+            const std::string reverse = IupacReverseComplement(pattern);
+            Site site;
+            site.recognition_sequence = x.getRecognitionSequence();
+            for(size_t i = 0; i < x.getEnzymeCount(); ++i){
+                std::string enzyme_acronym(x.getEnzymeAcronym(i));
+                // The enzyme's other orientation, which sorts first, covers this one
+                if(reverse < pattern && enzyme_patterns.count(std::make_pair(enzyme_acronym, reverse)) > 0)
+                    continue;
+                if(!kept.emplace(enzyme_acronym, pattern).second)
+                    continue;
+                site.enzyme_acronyms.push_back(std::move(enzyme_acronym));
+            }
+            if(site.enzyme_acronyms.empty())
+                return;
+            site.strand = '+';
+            patterns[pattern].push_back(site);
+            if(reverse != pattern){
+                site.strand = '-';
+                patterns[reverse].push_back(site);
+            }
+        });
+        Compile(patterns);
+    }
+
+    size_t numberOfPatterns() const{
+        return patterns_.size();
+    }
+
+    size_t numberOfWords() const{
+        return words_;
+    }
+
+    size_t maxPatternLength() const{
+        return max_length_;
+    }
+
+    bool isBase(char c) const{
+        return codes_[static_cast<unsigned char>(c)] != SKIP;
+    }
+
+    ScanState newState() const{
+        return ScanState{std::vector<Block>(blocks_, Block{0, 0}), 0};
+    }
+
+    // @text: the next part of a sequence. Line breaks and blanks are skipped; any
+    //  character other than A, C, G, T or U, in either case, matches no site.
+    // @state: the automaton's state after the previous part, from newState().
+    // @visit: called as visit(hit) for every site that ends in text, once per enzyme.
+    template <typename Visitor>
+    void scan(std::string_view text, ScanState &state, Visitor visit) const{
+        Block *active = state.active.data();
+        const Block *start = start_.data();
+        const Block *final = final_.data();
+        const size_t blocks = blocks_;
+        uint64_t position = state.position;
+        for(char c : text){
+            const uint8_t code = codes_[static_cast<unsigned char>(c)];
+            if(code == SKIP)
+                continue;
+            const Block *accept = &accepts_[code * blocks];
+            Block found = {0, 0};
+            for(size_t b = 0; b < blocks; ++b){
+                const Block next = ((active[b] << 1) | start[b]) & accept[b];
+                active[b] = next;
+                found |= next & final[b];
+            }
+            if((found[0] | found[1]) != 0)
+                Report(active, position, visit);
+            ++position;
+        }
+        state.position = position;
+    }
+
+  private:
+    struct Site{
+        std::string recognition_sequence;
+        std::vector<std::string> enzyme_acronyms;
+        char strand;
+    };
+
+    struct Pattern{
+        size_t length;
+        std::vector<Site> sites;
+    };
+
+    static const uint8_t NONE = 4;   // Row of accepts_ that matches nothing
+    static const uint8_t SKIP = 5;   // Line breaks and blanks
+
+    // Return pattern without the runs of N at its ends.
+    static std::string StripFlanks(const std::string &pattern){
+        size_t first = pattern.find_first_not_of("Nn");
+        if(first == std::string::npos)
+            return std::string();
+        size_t last = pattern.find_last_not_of("Nn");
+        return pattern.substr(first, last - first + 1);
+    }
+
+    // Pack the patterns into words, longest first, each into the first word with
+    // room for it, and build the start, final and per-base accept masks.
+    void Compile(const std::map<std::string, std::vector<Site>> &patterns){
+        std::vector<const std::pair<const std::string, std::vector<Site>> *> order;
+        for(const auto &pattern : patterns){
+            if(pattern.first.size() > 64)
+                throw IllegalArgumentException{ };
+            order.push_back(&pattern);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto *a, const auto *b){
+            return a->first.size() > b->first.size();
+        });
+
+        std::vector<size_t> used;    // Bits taken in each word
+        std::vector<std::pair<size_t, size_t>> placement;
+        for(const auto *pattern : order){
+            const size_t length = pattern->first.size();
+            size_t w = 0;
+            while(w < used.size() && used[w] + length > 64)
+                ++w;
+            if(w == used.size())
+                used.push_back(0);
+            placement.emplace_back(w, used[w]);
+            used[w] += length;
+        }
+
+        words_ = used.size();
+        blocks_ = (words_ + 1) / 2;
+        max_length_ = 0;
+        start_.assign(blocks_, Block{0, 0});
+        final_.assign(blocks_, Block{0, 0});
+        accepts_.assign(5 * blocks_, Block{0, 0});
+        owners_.assign(128 * blocks_, 0);
+        patterns_.clear();
+        for(size_t p = 0; p < order.size(); ++p){
+            const std::string &bases = order[p]->first;
+            const size_t w = placement[p].first;
+            const size_t offset = placement[p].second;
+            start_[w / 2][w % 2] |= uint64_t(1) << offset;
+            final_[w / 2][w % 2] |= uint64_t(1) << (offset + bases.size() - 1);
+            for(size_t i = 0; i < bases.size(); ++i){
+                const uint8_t mask = IupacMask(bases[i]);
+                for(int base = 0; base < 4; ++base)
+                    if(mask >> base & 1)
+                        accepts_[base * blocks_ + w / 2][w % 2] |= uint64_t(1) << (offset + i);
+            }
+            owners_[w * 64 + offset + bases.size() - 1] = patterns_.size();
+            patterns_.push_back(Pattern{bases.size(), order[p]->second});
+            max_length_ = std::max(max_length_, bases.size());
+        }
+
+        std::memset(codes_, NONE, sizeof(codes_));
+        const char *bases = "ACGT";
+        for(int base = 0; base < 4; ++base){
+            codes_[static_cast<unsigned char>(bases[base])] = base;
+            codes_[static_cast<unsigned char>(bases[base] | 0x20)] = base;
+        }
+        codes_[static_cast<unsigned char>('U')] = codes_[static_cast<unsigned char>('u')] = 3;
+        for(char blank : {'\n', '\r', ' ', '\t'})
+            codes_[static_cast<unsigned char>(blank)] = SKIP;
+    }
+
+    // Call visit(hit) for every pattern whose final bit is set in active.
+    // position is the offset of the base just read.
+    template <typename Visitor>
+    void Report(const Block *active, uint64_t position, Visitor &visit) const{
+        for(size_t w = 0; w < words_; ++w){
+            for(uint64_t ended = active[w / 2][w % 2] & final_[w / 2][w % 2]; ended != 0; ended &= ended - 1){
+                const Pattern &pattern = patterns_[owners_[w * 64 + __builtin_ctzll(ended)]];
+                for(const Site &site : pattern.sites)
+                    for(const std::string &enzyme_acronym : site.enzyme_acronyms)
+                        visit(SiteHit{position + 1 - pattern.length, uint32_t(pattern.length),
+                                      site.recognition_sequence, enzyme_acronym, site.strand});
+            }
+        }
+    }
+
+    size_t words_;
+    size_t blocks_;                   // Words rounded up to whole blocks
+    size_t max_length_;
+    std::vector<Block> start_;        // First position of every pattern
+    std::vector<Block> final_;        // Last position of every pattern
+    std::vector<Block> accepts_;      // accepts_[ code * blocks_ + b ]: positions that accept the base
+    std::vector<uint32_t> owners_;    // Pattern ending at each final bit
+    std::vector<Pattern> patterns_;
+    uint8_t codes_[256];              // Base code (0-3), NONE or SKIP of every character
+};
+
+// @scanner: the compiled enzyme set.
+// @fasta: the contents of a FASTA file: records of a '>' header line followed by
+//  sequence lines.
+// @visit: called as visit(record_name, hit) for every site in every record, where
+//  record_name is the header up to the first blank. Positions restart at 0 in
+//  each record, and no site spans two records.
+template <typename Visitor>
+void ScanFasta(const SiteScanner &scanner, std::string_view fasta, Visitor visit){
+    SiteScanner::ScanState state = scanner.newState();
+    std::string_view record_name;
+    size_t pos = 0;
+    while(pos < fasta.size()){
+        if(fasta[pos] == '>'){
+            size_t header_end = fasta.find('\n', pos);
+            if(header_end == std::string_view::npos)
+                header_end = fasta.size();
+            std::string_view header = fasta.substr(pos + 1, header_end - pos - 1);
+            record_name = header.substr(0, header.find_first_of(" \t\r"));
+            state = scanner.newState();
+            pos = header_end + 1;
+            continue;
+        }
+        size_t sequence_end = fasta.find("\n>", pos);
+        sequence_end = sequence_end == std::string_view::npos ? fasta.size() : sequence_end + 1;
+        scanner.scan(fasta.substr(pos, sequence_end - pos), state, [&](const SiteHit &hit){
+            visit(record_name, hit);
+        });
+        pos = sequence_end;
+    }
+}
+
+// @scanner: the compiled enzyme set.
+// @fasta: the contents of a FASTA file, as for ScanFasta().
+// @pool: the threads to scan on.
+// @visit: called as visit(record_name, hit) exactly as ScanFasta() calls it, in the
+//  same order, always on the calling thread.
+// @chunk_bytes: the amount of sequence text each task scans.
+// Each record is cut into chunks that are scanned in parallel. A chunk's scan
+// starts maxPatternLength() - 1 bases early, so every site ending in the chunk
+// is seen whole, and only the sites ending in the chunk are kept; a site across
+// a border thus belongs to exactly one chunk, the one holding its last base. Chunks are scanned a window at a
+// time and their hits are handed to visit in chunk order, which bounds the
+// memory held by hits not yet visited.
+template <typename Visitor>
+void ScanFastaParallel(const SiteScanner &scanner, std::string_view fasta, ThreadPool &pool,
+                       Visitor visit, size_t chunk_bytes = 1 << 18){
+    struct Chunk{
+        std::string_view record_name;
+        std::string_view warmup;        // Bases before the chunk, scanned but not reported
+        std::string_view text;
+        uint64_t first_base;            // Offset of the chunk's first base in its record
+        std::vector<SiteHit> hits;
+    };
+
+    // Cut every record into chunks
+    std::vector<Chunk> chunks;
+    const size_t overlap = scanner.maxPatternLength() > 0 ? scanner.maxPatternLength() - 1 : 0;
+    std::string_view record_name;
+    size_t pos = 0;
+    while(pos < fasta.size()){
+        if(fasta[pos] == '>'){
+            size_t header_end = fasta.find('\n', pos);
+            if(header_end == std::string_view::npos)
+                header_end = fasta.size();
+            std::string_view header = fasta.substr(pos + 1, header_end - pos - 1);
+            record_name = header.substr(0, header.find_first_of(" \t\r"));
+            pos = header_end + 1;
+            continue;
+        }
+        size_t sequence_end = fasta.find("\n>", pos);
+        sequence_end = sequence_end == std::string_view::npos ? fasta.size() : sequence_end + 1;
+        const size_t sequence_start = pos;
+        uint64_t first_base = 0;
+        while(pos < sequence_end){
+            const size_t end = std::min(sequence_end, pos + chunk_bytes);
+            size_t warmup_start = pos;
+            for(size_t bases = 0; warmup_start > sequence_start && bases < overlap; )
+                bases += scanner.isBase(fasta[--warmup_start]);
+            Chunk chunk;
+            chunk.record_name = record_name;
+            chunk.warmup = fasta.substr(warmup_start, pos - warmup_start);
+            chunk.text = fasta.substr(pos, end - pos);
+            chunk.first_base = first_base;
+            chunks.push_back(std::move(chunk));
+            for(; pos < end; ++pos)
+                first_base += scanner.isBase(fasta[pos]);
+        }
+    }
+
+    const size_t window = 4 * pool.size();
+    for(size_t first = 0; first < chunks.size(); first += window){
+        const size_t last = std::min(chunks.size(), first + window);
+        TaskGroup group(pool);
+        for(size_t i = first; i < last; ++i){
+            Chunk *chunk = &chunks[i];
+            group.run([&scanner, chunk](){
+                SiteScanner::ScanState state = scanner.newState();
+                uint64_t warmup_bases = 0;
+                for(char c : chunk->warmup)
+                    warmup_bases += scanner.isBase(c);
+                state.position = chunk->first_base - warmup_bases;
+                // Sites ending in the warmup belong to the chunk before
+                scanner.scan(chunk->warmup, state, [](const SiteHit &){ });
+                scanner.scan(chunk->text, state, [chunk](const SiteHit &hit){
+                    chunk->hits.push_back(hit);
+                });
+            });
+        }
+        group.wait();
+        for(size_t i = first; i < last; ++i){
+            for(const SiteHit &hit : chunks[i].hits)
+                visit(chunks[i].record_name, hit);
+            std::vector<SiteHit>().swap(chunks[i].hits);
+        }
+    }
+}
+
+#endif
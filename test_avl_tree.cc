@@ -0,0 +1,448 @@
+// File's Title: test_avl_tree.cc
+// Description: check the AVL invariants of the tree after every step of random mixes
+// of insert, remove by item, remove by key and remove with a call counter, against a
+// std::set of the keys, with the iterators and the order statistics select( ), rank( )
+// and countRange( ), the iterators of trees grown in ascending and descending order,
+// forEachWithPrefix( ) against a brute-force scan, and the exact rotations of
+// ascending, descending and zig-zag inserts.
+// Built twice: test_avl_tree checks avl_tree.h and test_avl_tree_mod, compiled with
+// -DMODIFIED_TREE, checks the direct double rotations of avl_tree_modified.h.
+
+#ifdef MODIFIED_TREE
+#include "avl_tree_modified.h"
+#else
+#include "avl_tree.h"
+#endif
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// The members of AvlTree<SequenceMap> without a Stats policy. NoStats is an empty
+// private base, so the tree must be no larger: instrumentation costs nothing unused.
+struct NoStatsBaseline{
+    void *root;
+    NodePool<SequenceMap> pool;
+    BlockedBloomFilter bloom;
+    size_t removed;
+    atomic<size_t> counters[4];
+};
+static_assert(sizeof(AvlTree<SequenceMap>) == sizeof(NoStatsBaseline), "NoStats takes room in AvlTree");
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @a_tree: the tree under test.
+// @model: the keys the tree must hold.
+// Return true if the tree is a valid AVL tree holding exactly the keys of model.
+template <typename TreeType>
+bool Matches(const TreeType &a_tree, const set<string> &model){
+    if(!a_tree.isValid() || size_t(a_tree.numberOfNodes()) != model.size())
+        return false;
+    auto expected = model.begin();
+    bool same = true;
+    a_tree.forEach([&](const SequenceMap &x){
+        if(expected == model.end() || x.getRecognitionSequence() != *expected)
+            same = false;
+        else
+            ++expected;
+    });
+    return same && expected == model.end();
+}
+
+// @a_tree: the tree under test.
+// @model: the keys the tree must hold.
+// Walk the tree with const_iterator forward from begin( ) and back from end( ),
+// and check both walks against the model, that --end( ) is the largest key,
+// that ++end( ) and --begin( ) throw, and that an empty tree has begin( ) == end( ).
+// Return the number of failed checks.
+template <typename TreeType>
+int CheckIterators(const TreeType &a_tree, const set<string> &model){
+    int failures = 0;
+    auto expected = model.begin();
+    for(auto itr = a_tree.begin(); itr != a_tree.end(); itr++){
+        if(expected == model.end() || itr->getRecognitionSequence() != *expected)
+            return failures + 1;
+        ++expected;
+    }
+    failures += expected != model.end();
+    auto reverse_expected = model.rbegin();
+    for(auto itr = a_tree.end(); itr != a_tree.begin(); ){
+        --itr;
+        if(reverse_expected == model.rend() || (*itr).getRecognitionSequence() != *reverse_expected)
+            return failures + 1;
+        ++reverse_expected;
+    }
+    failures += reverse_expected != model.rend();
+    if(model.empty())
+        failures += a_tree.begin() != a_tree.end();
+    else
+        failures += prev(a_tree.end())->getRecognitionSequence() != *model.rbegin();
+    for(bool forward : {true, false}){
+        try{
+            auto itr = forward ? a_tree.end() : a_tree.begin();
+            if(forward)
+                ++itr;
+            else
+                itr--;
+            ++failures;
+        }
+        catch(const IteratorOutOfBoundsException &){
+        }
+    }
+    return failures;
+}
+
+// @a_tree: the tree under test.
+// @model: the keys the tree must hold.
+// @full: check every key, not a random 64 of them.
+// @random: the generator.
+// Check select( k ) against the model, that select( -1 ) and select( size )
+// throw, rank( x ) of the keys, of keys just below and just above them, and of
+// keys below and above all of them, and countRange( ) of a few random pairs of
+// these, including empty and backwards ranges.
+// Return the number of failed checks.
+template <typename TreeType>
+int CheckOrder(const TreeType &a_tree, const set<string> &model, bool full, mt19937 &random){
+    int failures = 0;
+    vector<const string *> sorted;
+    for(const string &key : model)
+        sorted.push_back(&key);
+    vector<string> probes = {"", "zzz"};
+    const size_t checked = full ? sorted.size() : min(sorted.size(), size_t(64));
+    for(size_t i = 0; i < checked; ++i){
+        const size_t k = full ? i : random() % sorted.size();
+        const string &key = *sorted[k];
+        if(a_tree.select(int(k)).getRecognitionSequence() != key)
+            ++failures;
+        probes.push_back(key);
+        probes.push_back(key.substr(0, key.size() - 1));
+        probes.push_back(key + "A");
+    }
+    // The number of keys less than x, as std::distance( begin, lower_bound ) on
+    // the sorted keys, in O( log n )
+    auto rank = [&sorted](const string &x){
+        return distance(sorted.begin(), lower_bound(sorted.begin(), sorted.end(), x,
+                                                    [](const string *key, const string &x){ return *key < x; }));
+    };
+    for(int out_of_range : {-1, int(model.size())}){
+        try{
+            a_tree.select(out_of_range);
+            ++failures;
+        }
+        catch(const ArrayIndexOutOfBoundsException &){
+        }
+    }
+    for(const string &x : probes)
+        if(a_tree.rank(x) != rank(x))
+            ++failures;
+    for(int pair = 0; pair < 8; ++pair){
+        const string &lo = probes[random() % probes.size()];
+        const string &hi = pair == 0 ? lo : probes[random() % probes.size()];
+        const long expected = lo < hi ? rank(hi) - rank(lo) : 0;
+        if(a_tree.countRange(lo, hi) != expected)
+            ++failures;
+    }
+    return failures;
+}
+
+// @name: the name of the key set, for the report.
+// @keys: the keys to draw from; repeats are merged by the tree.
+// @steps: the number of random operations.
+// Insert, remove with a counter, remove by key and remove by item at random,
+// a quarter of the time each once the tree holds half the keys, and check the
+// tree, its iterators, select( ), rank( ) and countRange( ) after every step: fully while it
+// holds up to 256 keys, and on larger trees every 256 steps and by sample between.
+// Return the number of failed checks.
+int RandomMix(const string &name, const vector<string> &keys, int steps){
+    AvlTree<SequenceMap> a_tree;
+    set<string> model;
+    mt19937 random(steps);
+    int failures = 0;
+    int remove_recursive_call = 0;
+    for(int step = 0; step < steps; ++step){
+        const string &key = keys[random() % keys.size()];
+        const int operation = model.size() < keys.size() / 2 ? random() % 2 : random() % 4;
+        if(operation == 0){
+            a_tree.insert(SequenceMap(key, "Enz"));
+            model.insert(key);
+        }
+        else if(operation == 1){
+            const int calls_before = remove_recursive_call;
+            const bool removed = a_tree.remove(key, remove_recursive_call);
+            if(removed != (model.erase(key) == 1) || remove_recursive_call <= calls_before)
+                ++failures;
+        }
+        else if(operation == 2){
+            if(a_tree.remove(key) != int(model.erase(key)))
+                ++failures;
+        }
+        else{
+            a_tree.remove(SequenceMap(key, ""));
+            model.erase(key);
+        }
+        if(!Matches(a_tree, model))
+            ++failures;
+        failures += CheckIterators(a_tree, model);
+        failures += CheckOrder(a_tree, model, model.size() <= 256 || step % 256 == 0, random);
+    }
+    cout<<"mix/"<<name<<": "<<steps<<" steps, "<<a_tree.numberOfNodes()<<" nodes left, average depth ratio "
+        <<a_tree.averageDepthRatio()<<", "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys of the tree.
+// Check that a CountingStats tree counts each countRange( ) of a nonempty range
+// as one TREE_FIND, and an empty or backwards one as none.
+// Return the number of failed checks.
+int CheckCountRangeStats(const vector<string> &keys){
+    AvlTree<SequenceMap, NodePool, CountingStats> a_tree;
+    for(const string &key : keys)
+        a_tree.insert(SequenceMap(key, "Enz"));
+    mt19937 random(keys.size());
+    int failures = 0;
+    for(int i = 0; i < 1000; ++i){
+        const string &lo = keys[random() % keys.size()];
+        const string &hi = keys[random() % keys.size()];
+        a_tree.resetStats();
+        a_tree.countRange(lo, hi);
+        if(a_tree.stats().operations(TREE_FIND) != size_t(lo < hi))
+            ++failures;
+    }
+    cout<<"countRange stats: 1000 ranges, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys to insert.
+// Insert the keys in ascending and then in descending order, so that every
+// insert rotates at the edge of the tree, and walk the iterators after each,
+// which follow the parent links the rotations rewired.
+// Return the number of failed checks.
+int CheckSortedInserts(const vector<string> &keys){
+    const set<string> sorted(keys.begin(), keys.end());
+    int failures = CheckIterators(AvlTree<SequenceMap>(), set<string>());
+    for(bool ascending : {true, false}){
+        AvlTree<SequenceMap> a_tree;
+        set<string> model;
+        vector<string> order(sorted.begin(), sorted.end());
+        if(!ascending)
+            reverse(order.begin(), order.end());
+        for(const string &key : order){
+            a_tree.insert(SequenceMap(key, "Enz"));
+            model.insert(key);
+            failures += !Matches(a_tree, model);
+            failures += CheckIterators(a_tree, model);
+        }
+    }
+    cout<<"sorted inserts: "<<sorted.size()<<" keys each way, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @a_tree: a tree.
+// @model: each key of the tree with its enzyme acronyms in order.
+// @prefix: the prefix to look up.
+// Return true if forEachWithPrefix( prefix ) visits exactly the enzymes of the
+// keys of model that start with prefix, in order, and returns their number.
+template <typename TreeType>
+bool PrefixMatches(const TreeType &a_tree, const map<string, vector<string>> &model, const string &prefix){
+    vector<pair<string, string>> expected;
+    int expected_matches = 0;
+    for(const auto &entry : model)
+        if(entry.first.compare(0, prefix.size(), prefix) == 0){
+            ++expected_matches;
+            for(const string &acronym : entry.second)
+                expected.emplace_back(entry.first, acronym);
+        }
+    vector<pair<string, string>> visited;
+    const int matches = a_tree.forEachWithPrefix(prefix, [&visited](string_view sequence, string_view acronym){
+        visited.emplace_back(string(sequence), string(acronym));
+    });
+    return matches == expected_matches && visited == expected;
+}
+
+// @rebase: the REBASE records, as (acronym, sequence).
+// Check forEachWithPrefix( ) on the REBASE tree: the empty prefix, which visits
+// everything, a prefix longer than every key, a prefix that falls between two
+// keys and matches neither, whole keys, with and without longer keys after them,
+// and every proper prefix of every key and one just past it. Check the empty
+// prefix on an empty tree too.
+// Return the number of failed checks.
+int CheckPrefixes(const vector<pair<string, string>> &rebase){
+    AvlTree<SequenceMap> a_tree;
+    map<string, vector<string>> model;
+    size_t longest = 0;
+    for(const auto &record : rebase){
+        a_tree.insert(SequenceMap(record.second, record.first));
+        model[record.second].push_back(record.first);
+        longest = max(longest, record.second.size());
+    }
+    int failures = 0;
+    const auto check = [&](const string &name, const string &prefix){
+        if(!PrefixMatches(a_tree, model, prefix)){
+            cout<<"prefix/"<<name<<" \""<<prefix<<"\" failed"<<endl;
+            ++failures;
+        }
+    };
+    int visits = 0;
+    failures += a_tree.forEachWithPrefix("", [&visits](string_view, string_view){ ++visits; }) != int(model.size())
+        || visits != int(rebase.size());
+    check("empty", "");
+    check("longer than every key", string(longest + 1, 'A'));
+    check("longer than every key", model.rbegin()->first + "A");
+    // A key, the next key, and a prefix between them that no key starts with
+    for(auto following = next(model.begin()); following != model.end(); ++following){
+        const string &key = prev(following)->first;
+        if(following->first.compare(0, key.size(), key) == 0)
+            continue;
+        const string between = key + "Z";
+        failures += !(key < between && between < following->first);
+        failures += a_tree.forEachWithPrefix(between, [](string_view, string_view){ }) != 0;
+        check("between two keys", between);
+        break;
+    }
+    int keys_with_extensions = 0;
+    for(auto entry = model.begin(); entry != model.end(); ++entry){
+        const string &key = entry->first;
+        const auto after = next(entry);
+        keys_with_extensions += after != model.end() && after->first.compare(0, key.size(), key) == 0;
+        check("whole key", key);
+        for(size_t length = 1; length < key.size(); ++length)
+            check("proper prefix", key.substr(0, length));
+        string past = key;
+        ++past.back();
+        check("just past a key", past);
+    }
+    failures += keys_with_extensions == 0;
+    failures += AvlTree<SequenceMap>().forEachWithPrefix("", [](string_view, string_view){ }) != 0;
+    cout<<"prefixes: "<<model.size()<<" keys, "<<keys_with_extensions<<" extended by others, "
+        <<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @i: a number below 4^8.
+// Return it written in bases, eight of them, so that the keys sort as the numbers.
+string NumberedKey(int i){
+    string key(8, 'A');
+    for(int base = 7; base >= 0; --base, i /= 4)
+        key[base] = "ACGT"[i % 4];
+    return key;
+}
+
+// Insert the keys of NumberedKey( ) into a CountingStats tree in ascending,
+// descending and zig-zag orders, and check the exact numbers of LL, RR, LR and
+// RL rotations, worked out on a plain AVL insert. n keys inserted in order cost
+// n minus the number of levels of a complete tree of n nodes, all on one side;
+// three keys in zig-zag cost one double rotation; inserting from both ends
+// inward takes every kind.
+// Return the number of failed checks.
+int CheckRotationCounts(){
+    struct Case{
+        string name;
+        vector<int> order;
+        size_t ll, rr, lr, rl;
+    };
+    vector<int> ascending;
+    vector<int> ascending_1024;
+    vector<int> outside_in;
+    for(int i = 0; i < 1024; ++i)
+        ascending_1024.push_back(i);
+    ascending.assign(ascending_1024.begin(), ascending_1024.begin() + 1000);
+    const vector<int> descending(ascending.rbegin(), ascending.rend());
+    for(int low = 0, high = 999; low <= high; ++low, --high){
+        outside_in.push_back(low);
+        if(low != high)
+            outside_in.push_back(high);
+    }
+    const vector<Case> cases = {
+        {"ascending", ascending, 0, 990, 0, 0},
+        {"ascending-1023", vector<int>(ascending_1024.begin(), ascending_1024.end() - 1), 0, 1013, 0, 0},
+        {"ascending-1024", ascending_1024, 0, 1013, 0, 0},
+        {"descending", descending, 990, 0, 0, 0},
+        {"zig-zag-left-right", {2, 0, 1}, 0, 0, 1, 0},
+        {"zig-zag-right-left", {0, 2, 1}, 0, 0, 0, 1},
+        {"outside-in", outside_in, 189, 182, 305, 312},
+    };
+    int failures = 0;
+    for(const Case &test : cases){
+        AvlTree<SequenceMap, NodePool, CountingStats> a_tree;
+        for(int i : test.order)
+            a_tree.insert(SequenceMap(NumberedKey(i), "Enz"));
+        const CountingStats &stats = a_tree.stats();
+        const size_t ll = stats.total(TREE_ROTATE_WITH_LEFT_CHILD);
+        const size_t rr = stats.total(TREE_ROTATE_WITH_RIGHT_CHILD);
+        const size_t lr = stats.total(TREE_DOUBLE_WITH_LEFT_CHILD);
+        const size_t rl = stats.total(TREE_DOUBLE_WITH_RIGHT_CHILD);
+        if(!a_tree.isValid() || ll != test.ll || rr != test.rr || lr != test.lr || rl != test.rl){
+            cout<<"rotations/"<<test.name<<": LL "<<ll<<", RR "<<rr<<", LR "<<lr<<", RL "<<rl<<endl;
+            ++failures;
+        }
+    }
+    cout<<"rotations: "<<cases.size()<<" orders, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @number_of_keys: the number of keys.
+// Return random sequences that share a 9-base stem, so that most comparisons
+// tie on the inline key prefix and go on to the strings.
+vector<string> StemmedKeys(size_t number_of_keys){
+    mt19937_64 random(number_of_keys);
+    vector<string> keys;
+    for(size_t i = 0; i < number_of_keys; ++i){
+        string key = "GATTACAGA";
+        for(int base = 0; base < 6; ++base)
+            key += "ACGT"[random() % 4];
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+#ifdef MODIFIED_TREE
+    cout<<"Tree: AvlTree with direct double rotations (avl_tree_modified.h)"<<endl;
+#else
+    cout<<"Tree: AvlTree (avl_tree.h)"<<endl;
+#endif
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<string> rebase_keys;
+    vector<pair<string, string>> rebase;
+    ForEachRebaseRecord(db_file.contents(), [&](string_view enz_acro, string_view reco_seq){
+        rebase_keys.emplace_back(reco_seq);
+        rebase.emplace_back(enz_acro, reco_seq);
+    });
+
+    int failures = RandomMix("rebase", rebase_keys, 20000);
+    failures += RandomMix("stemmed", StemmedKeys(200), 20000);
+    failures += RandomMix("stemmed-large", StemmedKeys(5000), 50000);
+    failures += CheckCountRangeStats(rebase_keys);
+    failures += CheckSortedInserts(rebase_keys);
+    failures += CheckPrefixes(rebase);
+    failures += CheckRotationCounts();
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
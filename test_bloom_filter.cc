@@ -0,0 +1,398 @@
+// File's Title: test_bloom_filter.cc
+// Description: check that the Bloom filter of AvlTree stays in step with the tree
+// through every kind of change: inserts, the three removes, makeEmpty, copies and
+// moves, split and join, bulkLoad and buildFromSorted, and the set operations. After
+// each, every key the tree holds must be found, every other key not, by find( ),
+// contains( ) and findBatch( ), against a std::set, and the filter counters must
+// add up. Then check that the filter is rebuilt exactly when a quarter of it is
+// stale or it outgrows its size.
+
+#include "avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+typedef AvlTree<SequenceMap> Tree;
+
+// AvlTree's MIN_FILTER_KEYS: a filter is sized for twice the nodes, and never fewer
+const size_t kMinFilterKeys = 1024;
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @number_of_keys: the number of keys.
+// @seed: the seed of the generator.
+// Return distinct random 10-base sequences.
+vector<string> RandomKeys(size_t number_of_keys, unsigned seed){
+    mt19937 random(seed);
+    set<string> keys;
+    while(keys.size() < number_of_keys){
+        string key;
+        for(int base = 0; base < 10; ++base)
+            key += "ACGT"[random() % 4];
+        keys.insert(key);
+    }
+    vector<string> shuffled(keys.begin(), keys.end());
+    shuffle(shuffled.begin(), shuffled.end(), random);
+    return shuffled;
+}
+
+// @a_tree: a tree with a filter.
+// @model: the keys the tree must hold.
+// @probes: keys to look up, held or not; every key of the model among them.
+// Look up every probe with find( ), contains( ) and findBatch( ) and check the
+// answers against the model, and that the filter counters grew by one hit per
+// lookup of a held key and by one rejection or false positive per lookup of
+// any other, without a rebuild.
+// Return the number of failed checks.
+int Synced(const Tree &a_tree, const set<string> &model, const vector<string> &probes){
+    int failures = !a_tree.filterEnabled() || !a_tree.isValid() || size_t(a_tree.numberOfNodes()) != model.size();
+    const Tree::FilterCounters before = a_tree.filterCounters();
+    size_t held = 0;
+    for(const string &key : probes){
+        const bool in_model = model.count(key) == 1;
+        held += in_model;
+        int find_recursive_call = 0;
+        failures += a_tree.find(key, find_recursive_call) != int(in_model) || a_tree.contains(SequenceMap(key, "")) != in_model;
+    }
+    const vector<string_view> keys(probes.begin(), probes.end());
+    vector<int> found(keys.size());
+    int batch_recursive_call = 0;
+    failures += a_tree.findBatch(keys.data(), keys.size(), found.data(), batch_recursive_call) != int(held);
+    for(size_t i = 0; i < keys.size(); ++i)
+        failures += found[i] != int(model.count(probes[i]));
+    const Tree::FilterCounters after = a_tree.filterCounters();
+    const size_t absent = probes.size() - held;
+    failures += after.hits - before.hits != 3 * held;
+    failures += (after.rejected - before.rejected) + (after.falsePositives - before.falsePositives) != 3 * absent;
+    failures += after.rebuilds != before.rebuilds;
+    return failures;
+}
+
+// @a_tree: a tree with a filter.
+// @model: the keys the tree holds, kept up to date.
+// @key: a key.
+// @operation: which change to make, from 0 to 4.
+// Insert key by copy or by move, or remove it with a counter, by key or by item.
+// Return the number of failed checks on the return values.
+int Change(Tree &a_tree, set<string> &model, const string &key, int operation){
+    int failures = 0;
+    if(operation == 0){
+        const SequenceMap x(key, "Enz");
+        a_tree.insert(x);
+        model.insert(key);
+    }
+    else if(operation == 1){
+        a_tree.insert(SequenceMap(key, "Enz"));
+        model.insert(key);
+    }
+    else if(operation == 2){
+        int remove_recursive_call = 0;
+        failures += a_tree.remove(key, remove_recursive_call) != int(model.erase(key));
+    }
+    else if(operation == 3){
+        failures += a_tree.remove(key) != int(model.erase(key));
+    }
+    else{
+        a_tree.remove(SequenceMap(key, ""));
+        model.erase(key);
+    }
+    return failures;
+}
+
+// @keys: the keys to draw from.
+// @probes: the keys to look up.
+// Make random inserts and removes of every kind on a filtered tree, and empty
+// it halfway; look the changed key up after every step and every probe every
+// 100 steps and after makeEmpty( ).
+// Return the number of failed checks.
+int CheckChanges(const vector<string> &keys, const vector<string> &probes){
+    mt19937 random(1);
+    Tree a_tree;
+    set<string> model;
+    for(size_t i = 0; i < keys.size() / 4; ++i)
+        Change(a_tree, model, keys[i], 1);
+    a_tree.enableFilter();
+    const Tree::FilterCounters start = a_tree.filterCounters();
+    int failures = start.rejected + start.hits + start.falsePositives + start.rebuilds != 0;
+    failures += Synced(a_tree, model, probes);
+    const int steps = 6000;
+    for(int step = 0; step < steps; ++step){
+        const string &key = keys[random() % keys.size()];
+        failures += Change(a_tree, model, key, model.size() < keys.size() / 2 ? random() % 2 : random() % 5);
+        failures += Synced(a_tree, model, {key});
+        if(step == steps / 2){
+            a_tree.makeEmpty();
+            model.clear();
+            failures += Synced(a_tree, model, probes);
+        }
+        if(step % 100 == 99)
+            failures += Synced(a_tree, model, probes);
+    }
+    // The never inserted probes, a third of every full lookup, must mostly end at the filter
+    const Tree::FilterCounters counters = a_tree.filterCounters();
+    failures += counters.rejected <= counters.falsePositives;
+    cout<<"changes: "<<steps<<" steps, "<<counters.rejected<<" rejected, "<<counters.falsePositives
+        <<" false positives, "<<counters.rebuilds<<" rebuilds, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys.
+// @probes: the keys to look up.
+// Copy a filtered tree by the copy constructor and by assignment, and move it
+// by the move constructor and by assignment; each must keep a filter in step
+// with it. Then change the tree, which must leave the copies alone.
+// Return the number of failed checks.
+int CheckCopies(const vector<string> &keys, const vector<string> &probes){
+    Tree a_tree;
+    set<string> model;
+    for(size_t i = 0; i < keys.size() / 2; ++i)
+        Change(a_tree, model, keys[i], 1);
+    a_tree.enableFilter();
+    const Tree copy(a_tree);
+    Tree assigned;
+    assigned = a_tree;
+    Tree moved_from(a_tree);
+    const Tree moved(std::move(moved_from));
+    Tree move_assigned_from(a_tree);
+    Tree move_assigned;
+    move_assigned = std::move(move_assigned_from);
+    const set<string> old_model = model;
+    int failures = 0;
+    for(const Tree *version : vector<const Tree *>{&a_tree, &copy, &assigned, &moved, &move_assigned})
+        failures += Synced(*version, model, probes);
+    mt19937 random(2);
+    for(int step = 0; step < 2000; ++step)
+        failures += Change(a_tree, model, keys[random() % keys.size()], random() % 5);
+    failures += Synced(a_tree, model, probes);
+    for(const Tree *version : vector<const Tree *>{&copy, &assigned, &moved, &move_assigned})
+        failures += Synced(*version, old_model, probes);
+    cout<<"copies: 4 copies, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys.
+// @probes: the keys to look up.
+// Split a filtered tree around keys held and not held, into a tree with a
+// filter holding other keys and into one without, and join the halves back.
+// Each filtered half must be in step with its keys, and the tree without one
+// must stay so.
+// Return the number of failed checks.
+int CheckSplitJoin(const vector<string> &keys, const vector<string> &probes){
+    Tree a_tree;
+    set<string> model;
+    for(size_t i = 0; i < keys.size() / 2; ++i)
+        Change(a_tree, model, keys[i], 1);
+    a_tree.enableFilter();
+    int failures = 0;
+    int splits = 0;
+    for(size_t i = 0; i < keys.size(); i += keys.size() / 16){
+        const string &x = keys[i];
+        for(bool filtered : {true, false}){
+            Tree greater;
+            greater.insert(SequenceMap(keys.back(), "Other"));
+            if(filtered)
+                greater.enableFilter();
+            a_tree.split(x, greater);
+            const set<string> less_model(model.begin(), model.lower_bound(x));
+            const set<string> greater_model(model.lower_bound(x), model.end());
+            failures += Synced(a_tree, less_model, probes);
+            failures += greater.filterEnabled() != filtered || size_t(greater.numberOfNodes()) != greater_model.size();
+            if(filtered)
+                failures += Synced(greater, greater_model, probes);
+            a_tree.join(std::move(greater));
+            failures += !greater.isEmpty();
+            failures += Synced(a_tree, model, probes);
+            ++splits;
+        }
+    }
+    cout<<"split/join: "<<splits<<" splits, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys.
+// @probes: the keys to look up.
+// Replace the items of a filtered tree with bulkLoad( ), from unsorted items
+// with repeats, and with buildFromSorted( ), into trees that held other keys,
+// and into an empty one.
+// Return the number of failed checks.
+int CheckBulkBuilds(const vector<string> &keys, const vector<string> &probes){
+    int failures = 0;
+    const size_t quarter = keys.size() / 4;
+    for(size_t start : {size_t(0), quarter, 2 * quarter}){
+        Tree a_tree;
+        if(start > 0)
+            for(size_t i = 0; i < quarter; ++i)
+                a_tree.insert(SequenceMap(keys[i], "Old"));
+        a_tree.enableFilter();
+        vector<SequenceMap> items;
+        set<string> model;
+        for(size_t i = start; i < start + quarter + start / 2; ++i){
+            items.push_back(SequenceMap(keys[i], "Enz"));
+            items.push_back(SequenceMap(keys[start + (i * 7) % quarter], "Again"));
+            model.insert(keys[i]);
+        }
+        a_tree.bulkLoad(items.begin(), items.end());
+        failures += Synced(a_tree, model, probes);
+        vector<SequenceMap> sorted;
+        for(const string &key : model)
+            sorted.push_back(SequenceMap(key, "Sorted"));
+        set<string> half_model;
+        for(size_t i = 0; i < sorted.size(); i += 2)
+            half_model.insert(sorted[i].getRecognitionSequence());
+        vector<SequenceMap> half;
+        for(size_t i = 0; i < sorted.size(); i += 2)
+            half.push_back(sorted[i]);
+        a_tree.buildFromSorted(half.begin(), half.end());
+        failures += Synced(a_tree, half_model, probes);
+    }
+    cout<<"bulk builds: 6 builds, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys.
+// @probes: the keys to look up.
+// Combine a filtered tree with overlapping trees by unionWith( ), intersect( )
+// and difference( ); each result must keep a filter in step with it.
+// Return the number of failed checks.
+int CheckSetOperations(const vector<string> &keys, const vector<string> &probes){
+    const size_t third = keys.size() / 3;
+    const auto build = [&keys](size_t from, size_t to, set<string> &model){
+        Tree a_tree;
+        for(size_t i = from; i < to; ++i){
+            a_tree.insert(SequenceMap(keys[i], "Enz"));
+            model.insert(keys[i]);
+        }
+        return a_tree;
+    };
+    int failures = 0;
+    for(int operation = 0; operation < 3; ++operation){
+        set<string> model;
+        set<string> rhs_model;
+        Tree a_tree = build(0, 2 * third, model);
+        a_tree.enableFilter();
+        Tree rhs = build(third, 3 * third, rhs_model);
+        set<string> expected;
+        if(operation == 0){
+            a_tree.unionWith(std::move(rhs));
+            set_union(model.begin(), model.end(), rhs_model.begin(), rhs_model.end(), inserter(expected, expected.end()));
+        }
+        else if(operation == 1){
+            a_tree.intersect(std::move(rhs));
+            set_intersection(model.begin(), model.end(), rhs_model.begin(), rhs_model.end(),
+                             inserter(expected, expected.end()));
+        }
+        else{
+            a_tree.difference(std::move(rhs));
+            set_difference(model.begin(), model.end(), rhs_model.begin(), rhs_model.end(),
+                           inserter(expected, expected.end()));
+        }
+        failures += Synced(a_tree, expected, probes);
+    }
+    cout<<"set operations: 3 operations, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys, more than kMinFilterKeys.
+// @probes: the keys to look up.
+// Fill a tree with 300 keys and enable its filter, which is then sized for
+// kMinFilterKeys keys. Removing a quarter of that must leave the filter as it
+// is and the next remove rebuild it, with misses and absent keys in between
+// counting for nothing. Then, from 300 keys again, the filter must be rebuilt
+// by the insert that finds it holding kMinFilterKeys keys, and not before.
+// disableFilter( ) must drop it and its counters and leave the tree as it is.
+// Return the number of failed checks.
+int CheckRebuilds(const vector<string> &keys, const vector<string> &probes){
+    const size_t start = 300;
+    int failures = 0;
+    {
+        Tree a_tree;
+        set<string> model;
+        for(size_t i = 0; i < start; ++i)
+            Change(a_tree, model, keys[i], 1);
+        a_tree.enableFilter();
+        for(size_t removed = 1; removed <= kMinFilterKeys / 4 + 1; ++removed){
+            failures += Change(a_tree, model, keys[removed - 1], 2 + removed % 3);
+            failures += Change(a_tree, model, keys[keys.size() - removed], 2 + removed % 3);
+            const size_t expected = removed > kMinFilterKeys / 4;
+            if(a_tree.filterCounters().rebuilds != expected){
+                cout<<"rebuilds: "<<a_tree.filterCounters().rebuilds<<" after "<<removed<<" removes"<<endl;
+                ++failures;
+            }
+        }
+        failures += Synced(a_tree, model, probes);
+        a_tree.disableFilter();
+        const Tree::FilterCounters counters = a_tree.filterCounters();
+        failures += a_tree.filterEnabled() || counters.rejected + counters.hits + counters.rebuilds != 0;
+        failures += size_t(a_tree.numberOfNodes()) != model.size();
+        for(const string &key : probes)
+            failures += a_tree.contains(SequenceMap(key, "")) != (model.count(key) == 1);
+        failures += a_tree.filterCounters().rejected + a_tree.filterCounters().hits != 0;
+    }
+    {
+        Tree a_tree;
+        set<string> model;
+        for(size_t i = 0; i < start; ++i)
+            Change(a_tree, model, keys[i], 1);
+        a_tree.enableFilter();
+        for(size_t inserted = 1; start + inserted <= kMinFilterKeys + 1; ++inserted){
+            Change(a_tree, model, keys[start + inserted - 1], inserted % 2);
+            const size_t expected = start + inserted > kMinFilterKeys;
+            if(a_tree.filterCounters().rebuilds != expected){
+                cout<<"rebuilds: "<<a_tree.filterCounters().rebuilds<<" after "<<inserted<<" inserts"<<endl;
+                ++failures;
+            }
+        }
+        failures += Synced(a_tree, model, probes);
+    }
+    cout<<"rebuilds: "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    set<string> rebase_keys;
+    ForEachRebaseRecord(db_file.contents(), [&rebase_keys](string_view, string_view reco_seq){
+        rebase_keys.emplace(reco_seq);
+    });
+    // The keys to insert, and as many again never inserted, which the filter should reject
+    vector<string> keys(rebase_keys.begin(), rebase_keys.end());
+    const vector<string> random_keys = RandomKeys(4000, 42);
+    keys.insert(keys.end(), random_keys.begin(), random_keys.begin() + 2000);
+    vector<string> probes = keys;
+    probes.insert(probes.end(), random_keys.begin() + 2000, random_keys.end());
+
+    int failures = CheckChanges(keys, probes);
+    failures += CheckCopies(keys, probes);
+    failures += CheckSplitJoin(keys, probes);
+    failures += CheckBulkBuilds(keys, probes);
+    failures += CheckSetOperations(keys, probes);
+    failures += CheckRebuilds(keys, probes);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
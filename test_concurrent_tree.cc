@@ -0,0 +1,190 @@
+// File's Title: test_concurrent_tree.cc
+// Description: stress the concurrent AVL tree with many reader threads while one
+// writer keeps inserting and removing, check every answer against what a
+// single-threaded AvlTree allows, then measure how read throughput scales.
+
+#include "avl_tree.h"
+#include "concurrent_avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @a_tree: any tree with forEach().
+// Return the tree's contents, one item per line, in sorted order.
+template <typename TreeType>
+string Contents(const TreeType &a_tree){
+    ostringstream out;
+    a_tree.forEach([&out](const SequenceMap &x){ out<<x<<"\n"; });
+    return out.str();
+}
+
+// @records: every (recognition sequence, enzyme acronym) pair of the database.
+// @readers: the number of reader threads.
+// Keep half of the records in the tree the whole time, and let the writer
+// insert and remove the other half over and over while the readers check
+// that the stable half is always found, that keys never inserted are never
+// found, and that every version they walk is sorted and holds the stable half.
+// The writer replays the same updates on a single-threaded AvlTree; every
+// remove with a counter must count as many visits in both, and both trees
+// must end with the same contents.
+// Return the number of failed checks.
+int StressTest(const vector<pair<string, string>> &records, int readers){
+    ConcurrentAvlTree<SequenceMap> shared_tree;
+    AvlTree<SequenceMap> plain_tree;
+    // Removal takes out a whole node, so split by distinct recognition sequence
+    unordered_map<string, bool> is_stable;
+    vector<string> stable_keys, volatile_keys;
+    vector<const pair<string, string> *> volatile_records;
+    for(const auto &record : records){
+        auto inserted = is_stable.emplace(record.first, is_stable.size() % 2 == 0);
+        bool stable = inserted.first->second;
+        if(inserted.second)
+            (stable ? stable_keys : volatile_keys).push_back(record.first);
+        if(stable){
+            shared_tree.insert(SequenceMap(record.first, record.second));
+            plain_tree.insert(SequenceMap(record.first, record.second));
+        }
+        else
+            volatile_records.push_back(&record);
+    }
+    const size_t stable_nodes = plain_tree.numberOfNodes();
+
+    atomic<bool> done(false);
+    atomic<int> failures(0);
+    atomic<long long> reads(0);
+    vector<thread> threads;
+    for(int r = 0; r < readers; ++r){
+        threads.emplace_back([&, r](){
+            long long my_reads = 0;
+            size_t i = r;
+            while(!done.load()){
+                const string &stable = stable_keys[i % stable_keys.size()];
+                int visited = 0;
+                if(!shared_tree.find(stable, visited))
+                    ++failures;
+                if(shared_tree.contains(SequenceMap(stable + "#", "")))
+                    ++failures;
+                if(i % 64 == 0){
+                    size_t nodes = 0;
+                    string last;
+                    bool sorted = true;
+                    shared_tree.forEach([&](const SequenceMap &x){
+                        if(nodes > 0 && !(last < x.getRecognitionSequence()))
+                            sorted = false;
+                        last = x.getRecognitionSequence();
+                        ++nodes;
+                    });
+                    if(!sorted || nodes < stable_nodes)
+                        ++failures;
+                }
+                my_reads += 2;
+                ++i;
+            }
+            reads += my_reads;
+        });
+    }
+
+    const int kRounds = 200;
+    for(int round = 0; round < kRounds; ++round){
+        for(const pair<string, string> *record : volatile_records){
+            const SequenceMap sequence_map(record->first, record->second);
+            shared_tree.insert(sequence_map);
+            plain_tree.insert(sequence_map);
+        }
+        for(size_t i = 0; i < volatile_keys.size(); i += 2){
+            int shared_calls = 0, plain_calls = 0;
+            if(shared_tree.remove(volatile_keys[i], shared_calls) != plain_tree.remove(volatile_keys[i], plain_calls)
+               || shared_calls != plain_calls)
+                ++failures;
+        }
+        for(size_t i = 1; i < volatile_keys.size(); i += 2){
+            const SequenceMap sequence_map(volatile_keys[i], "");
+            shared_tree.remove(sequence_map);
+            plain_tree.remove(sequence_map);
+        }
+    }
+    done = true;
+    for(thread &t : threads)
+        t.join();
+
+    if(Contents(shared_tree) != Contents(plain_tree) || shared_tree.numberOfNodes() != plain_tree.numberOfNodes())
+        ++failures;
+    cout<<"stress: "<<readers<<" readers, "<<kRounds<<" writer rounds, "<<reads.load()<<" reads, "
+        <<failures.load()<<" failures"<<endl;
+    return failures.load();
+}
+
+// @records: every (recognition sequence, enzyme acronym) pair of the database.
+// @max_readers: the largest number of reader threads to try.
+// Report read-only lookup throughput for 1, 2, 4, ... reader threads.
+void ScalingTest(const vector<pair<string, string>> &records, int max_readers){
+    ConcurrentAvlTree<SequenceMap> shared_tree;
+    for(const auto &record : records)
+        shared_tree.insert(SequenceMap(record.first, record.second));
+
+    for(int readers = 1; readers <= max_readers; readers *= 2){
+        atomic<bool> done(false);
+        atomic<long long> reads(0);
+        vector<thread> threads;
+        for(int r = 0; r < readers; ++r){
+            threads.emplace_back([&, r](){
+                long long my_reads = 0;
+                int visited = 0;
+                for(size_t i = r; !done.load(memory_order_relaxed); ++i){
+                    shared_tree.find(records[i % records.size()].first, visited);
+                    ++my_reads;
+                }
+                reads += my_reads;
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(300));
+        done = true;
+        for(thread &t : threads)
+            t.join();
+        cout<<"scaling: "<<readers<<" readers, "<<reads.load()/0.3/1e6<<" M lookups/s"<<endl;
+    }
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<pair<string, string>> records;
+    ForEachRebaseRecord(db_file.contents(), [&records](string_view enz_acro, string_view reco_seq){
+        records.emplace_back(string(reco_seq), string(enz_acro));
+    });
+
+    const int cores = max(2u, thread::hardware_concurrency());
+    int failures = StressTest(records, cores - 1);
+    ScalingTest(records, cores);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
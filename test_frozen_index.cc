@@ -0,0 +1,215 @@
+// File's Title: test_frozen_index.cc
+// Description: freeze trees of every size around the powers of two, from empty up,
+// and the REBASE tree, and check that the FrozenSequenceIndex answers find( ),
+// contains( ), findRecoSeq( ) and forEach( ) as the tree does, for every key, for
+// keys that tie with them on the first seven bytes, and for absent keys below the
+// smallest and above the largest.
+
+#include "avl_tree.h"
+#include "frozen_sequence_index.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @print: anything that prints to cout.
+// Return what it printed.
+string Printed(const function<void()> &print){
+    ostringstream out;
+    streambuf *old_buffer = cout.rdbuf(out.rdbuf());
+    print();
+    cout.rdbuf(old_buffer);
+    return out.str();
+}
+
+// @n: the number of nodes of an index.
+// Return the number of levels of its implicit tree.
+int Levels(int n){
+    int levels = 0;
+    for(; n > 0; n /= 2)
+        ++levels;
+    return levels;
+}
+
+// @name: the name of the tree, for the report.
+// @a_tree: a tree.
+// @probes: keys to look up, held by the tree or not.
+// Freeze the tree and a copy of the index, and compare numberOfNodes( ),
+// forEach( ), and find( ), contains( ) and findRecoSeq( ) of every key of the
+// tree and every probe, with the tree. A search runs to a leaf, so it must
+// visit every level of the implicit tree, or all but the last.
+// Return the number of failed checks.
+int CheckIndex(const string &name, const AvlTree<SequenceMap> &a_tree, const vector<string> &probes){
+    const FrozenSequenceIndex frozen = Freeze(a_tree);
+    const FrozenSequenceIndex copy = frozen;
+    int failures = 0;
+    vector<string> expected;
+    vector<string> keys = probes;
+    a_tree.forEach([&expected, &keys](const SequenceMap &x){
+        string line = x.getRecognitionSequence();
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            line += " " + string(x.getEnzymeAcronym(i));
+        expected.push_back(line);
+        keys.push_back(x.getRecognitionSequence());
+    });
+    const int levels = Levels(a_tree.numberOfNodes());
+    for(const FrozenSequenceIndex *index : {&frozen, &copy}){
+        failures += index->numberOfNodes() != a_tree.numberOfNodes();
+        vector<string> found;
+        index->forEach([&found](string_view sequence, const vector<string_view> &acronyms){
+            string line(sequence);
+            for(string_view acronym : acronyms)
+                line += " " + string(acronym);
+            found.push_back(line);
+        });
+        failures += found != expected;
+        for(const string &key : keys){
+            int visited = 0;
+            int tree_calls = 0;
+            const int in_tree = a_tree.find(key, tree_calls);
+            if(index->find(key, visited) != in_tree || index->contains(key) != bool(in_tree)
+               || visited > levels || visited < levels - 1){
+                cout<<"index/"<<name<<": \""<<key<<"\" found "<<index->find(key, visited)<<", in the tree "
+                    <<in_tree<<endl;
+                ++failures;
+            }
+            if(Printed([&](){ index->findRecoSeq(key); }) != Printed([&](){ a_tree.findRecoSeq(key); }))
+                ++failures;
+        }
+    }
+    cout<<"index/"<<name<<": "<<a_tree.numberOfNodes()<<" nodes, "<<keys.size()<<" queries, "
+        <<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @key: a key.
+// Return keys next to it that the tree need not hold: a key with one more
+// character, the key cut short by one, and the key with its last character
+// one lower and one higher.
+vector<string> Neighbours(const string &key){
+    vector<string> neighbours = {key + "A"};
+    if(!key.empty()){
+        neighbours.push_back(key.substr(0, key.size() - 1));
+        for(int step : {-1, 1}){
+            string changed = key;
+            changed.back() = char(changed.back() + step);
+            neighbours.push_back(changed);
+        }
+    }
+    return neighbours;
+}
+
+// @name: the name of the key set, for the report.
+// @pool: the keys to draw from, in random order and without repeats.
+// @acronyms: the acronyms of each key.
+// For every size from 0 to 3 and 2^k - 1, 2^k and 2^k + 1 up to the whole pool,
+// freeze a tree of the first keys of the pool and check the index, probing
+// with the keys of the pool it does not hold, the neighbours of every key, and
+// keys below and above all of them.
+// Return the number of failed checks.
+int CheckSizes(const string &name, const vector<string> &pool, const vector<vector<string>> &acronyms){
+    set<size_t> sizes = {0, 1, 2, 3, pool.size()};
+    for(size_t power = 4; power / 2 <= pool.size(); power *= 2)
+        for(size_t size : {power - 1, power, power + 1})
+            if(size <= pool.size())
+                sizes.insert(size);
+    vector<string> probes = pool;
+    for(const string &key : pool){
+        const vector<string> neighbours = Neighbours(key);
+        probes.insert(probes.end(), neighbours.begin(), neighbours.end());
+    }
+    // Below the smallest key and above the largest
+    probes.insert(probes.end(), {"", "!", "'", "zzz", "~~~~~~~~~~~~"});
+    int failures = 0;
+    for(size_t size : sizes){
+        AvlTree<SequenceMap> a_tree;
+        for(size_t i = 0; i < size; ++i)
+            for(const string &acronym : acronyms[i])
+                a_tree.insert(SequenceMap(pool[i], acronym));
+        failures += CheckIndex(name + "/" + to_string(size), a_tree, probes);
+    }
+    return failures;
+}
+
+// @number_of_keys: the number of keys.
+// Return keys that all start with the seven bytes GATTACA, of eight to fourteen
+// bases, so that their fingerprints tie and the search reads the sequences,
+// and the seven-byte and six-byte keys that sort before them, in random order.
+vector<string> TiedKeys(size_t number_of_keys){
+    mt19937 random(number_of_keys);
+    set<string> keys = {"GATTACA", "GATTAC"};
+    while(keys.size() < number_of_keys){
+        string key = "GATTACA";
+        const int length = 1 + random() % 7;
+        for(int base = 0; base < length; ++base)
+            key += "ACGT"[random() % 4];
+        keys.insert(key);
+    }
+    vector<string> shuffled(keys.begin(), keys.end());
+    shuffle(shuffled.begin(), shuffled.end(), random);
+    return shuffled;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<string> rebase_pool;
+    vector<vector<string>> rebase_acronyms;
+    ForEachRebaseRecord(db_file.contents(), [&](string_view enz_acro, string_view reco_seq){
+        const auto found = find(rebase_pool.begin(), rebase_pool.end(), reco_seq);
+        if(found == rebase_pool.end()){
+            rebase_pool.emplace_back(reco_seq);
+            rebase_acronyms.push_back({string(enz_acro)});
+        }
+        else
+            rebase_acronyms[found - rebase_pool.begin()].emplace_back(enz_acro);
+    });
+    // Draw the REBASE sequences in random order, each with its acronyms
+    vector<size_t> order(rebase_pool.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(210));
+    vector<string> shuffled_pool;
+    vector<vector<string>> shuffled_acronyms;
+    for(size_t i : order){
+        shuffled_pool.push_back(rebase_pool[i]);
+        shuffled_acronyms.push_back(rebase_acronyms[i]);
+    }
+    const vector<string> tied_pool = TiedKeys(300);
+    vector<vector<string>> tied_acronyms;
+    for(size_t i = 0; i < tied_pool.size(); ++i)
+        tied_acronyms.push_back({"Enz" + to_string(i)});
+
+    int failures = CheckSizes("rebase", shuffled_pool, shuffled_acronyms);
+    failures += CheckSizes("tied", tied_pool, tied_acronyms);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
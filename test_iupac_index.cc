@@ -0,0 +1,206 @@
+// File's Title: test_iupac_index.cc
+// Description: check every IupacIndex lookup against a naive per-base IUPAC comparison
+// with every pattern, on the REBASE patterns and on synthetic buckets that fill
+// several 64-pattern blocks.
+
+#include "avl_tree.h"
+#include "iupac_index.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @code: an upper case IUPAC code.
+// Return the bases code stands for, spelled out, independently of IupacMask().
+string Expand(char code){
+    switch(code){
+      case 'A': return "A";
+      case 'C': return "C";
+      case 'G': return "G";
+      case 'T': return "T";
+      case 'R': return "AG";
+      case 'Y': return "CT";
+      case 'S': return "CG";
+      case 'W': return "AT";
+      case 'K': return "GT";
+      case 'M': return "AC";
+      case 'B': return "CGT";
+      case 'D': return "AGT";
+      case 'H': return "ACT";
+      case 'V': return "ACG";
+      case 'N': return "ACGT";
+      default: return "";
+    }
+}
+
+// A pattern as the naive matcher sees it: the recognition sequence, the bases
+// without the cut marks, and the enzymes.
+struct NaivePattern{
+    string recognition_sequence;
+    string bases;
+    vector<string> enzyme_acronyms;
+};
+
+// Return true if every base of kmer is one the pattern accepts at that position.
+bool NaiveMatches(const NaivePattern &pattern, string_view kmer){
+    if(pattern.bases.size() != kmer.size())
+        return false;
+    for(size_t i = 0; i < kmer.size(); ++i){
+        const char base = kmer[i] & ~0x20;
+        if(Expand(pattern.bases[i]).find(base) == string::npos || Expand(base).size() != 1)
+            return false;
+    }
+    return true;
+}
+
+// @a_tree: the tree the index and the naive patterns come from.
+// Return its patterns, cut marks stripped by hand; empty ones are left out.
+template <typename TreeType>
+vector<NaivePattern> NaivePatterns(const TreeType &a_tree){
+    vector<NaivePattern> patterns;
+    a_tree.forEach([&patterns](const SequenceMap &x){
+        NaivePattern pattern;
+        pattern.recognition_sequence = x.getRecognitionSequence();
+        for(char c : pattern.recognition_sequence)
+            if(c != '\'')
+                pattern.bases += c;
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            pattern.enzyme_acronyms.emplace_back(x.getEnzymeAcronym(i));
+        if(!pattern.bases.empty())
+            patterns.push_back(pattern);
+    });
+    return patterns;
+}
+
+// @pattern: a pattern.
+// @random: the generator.
+// Return a concrete k-mer the pattern matches, in random case.
+string Instance(const NaivePattern &pattern, mt19937_64 &random){
+    string kmer;
+    for(char code : pattern.bases){
+        const string bases = Expand(code);
+        char base = bases.empty() ? 'A' : bases[random() % bases.size()];
+        kmer += random() % 2 ? base : char(base | 0x20);
+    }
+    return kmer;
+}
+
+// @name: the name of the pattern set, for the report.
+// @a_tree: the patterns.
+// @queries: the number of random k-mers of each length, on top of an instance
+//  of every pattern and one with a base changed.
+// Look every k-mer up in the index and compare the (sequence, enzyme) pairs it
+// visits and the count it returns with those of the naive matcher.
+// Return the number of lookups that differ.
+template <typename TreeType>
+int CheckIndex(const string &name, const TreeType &a_tree, int queries){
+    const IupacIndex index(a_tree);
+    const vector<NaivePattern> patterns = NaivePatterns(a_tree);
+    if(index.numberOfPatterns() != patterns.size()){
+        cout<<name<<": "<<index.numberOfPatterns()<<" patterns indexed, "<<patterns.size()<<" expected"<<endl;
+        return 1;
+    }
+    mt19937_64 random(queries);
+    vector<string> kmers;
+    size_t max_length = 0;
+    for(const NaivePattern &pattern : patterns){
+        string kmer = Instance(pattern, random);
+        kmers.push_back(kmer);
+        kmer[random() % kmer.size()] = "ACGT"[random() % 4];
+        kmers.push_back(kmer);
+        max_length = max(max_length, pattern.bases.size());
+    }
+    for(size_t length = 0; length <= max_length + 1; ++length)
+        for(int i = 0; i < queries; ++i){
+            string kmer;
+            for(size_t j = 0; j < length; ++j)
+                kmer += "ACGT"[random() % 4];
+            kmers.push_back(kmer);
+        }
+    // Not concrete DNA: match nothing
+    kmers.push_back("GAANNTTC");
+    kmers.push_back("GAATTC'");
+
+    int failures = 0;
+    size_t hits = 0;
+    for(const string &kmer : kmers){
+        vector<pair<string, string>> found, expected;
+        const int matches = index.findMatches(kmer, [&found](string_view sequence, string_view acronym){
+            found.emplace_back(string(sequence), string(acronym));
+        });
+        int expected_matches = 0;
+        for(const NaivePattern &pattern : patterns)
+            if(NaiveMatches(pattern, kmer)){
+                ++expected_matches;
+                for(const string &acronym : pattern.enzyme_acronyms)
+                    expected.emplace_back(pattern.recognition_sequence, acronym);
+            }
+        sort(found.begin(), found.end());
+        sort(expected.begin(), expected.end());
+        if(matches != expected_matches || found != expected)
+            ++failures;
+        hits += expected_matches;
+    }
+    cout<<name<<": "<<patterns.size()<<" patterns, "<<kmers.size()<<" lookups, "<<hits<<" matches, "
+        <<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @number_of_patterns: the number of patterns.
+// @length: their length.
+// Return a tree of random degenerate patterns of one length, so that its one
+// bucket spans several 64-pattern blocks and a partly filled last one.
+AvlTree<SequenceMap> SyntheticPatterns(size_t number_of_patterns, size_t length){
+    const string codes = "ACGTRYSWKMBDHVN";
+    mt19937_64 random(number_of_patterns * length);
+    AvlTree<SequenceMap> a_tree;
+    while(size_t(a_tree.numberOfNodes()) < number_of_patterns){
+        string pattern;
+        for(size_t i = 0; i < length; ++i)
+            pattern += codes[random() % 8 == 0 ? 4 + random() % 11 : random() % 4];
+        a_tree.insert(SequenceMap(pattern, "Syn" + to_string(a_tree.numberOfNodes())));
+    }
+    return a_tree;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    AvlTree<SequenceMap> rebase_tree;
+    ForEachRebaseRecord(db_file.contents(), [&rebase_tree](string_view enz_acro, string_view reco_seq){
+        rebase_tree.insert(SequenceMap(reco_seq, enz_acro));
+    });
+
+    int failures = CheckIndex("rebase", rebase_tree, 20000);
+    // 63, 64, 65 and 200 patterns: one block short of full, exactly full, one over, several
+    for(size_t number_of_patterns : {63, 64, 65, 200})
+        failures += CheckIndex("synthetic/" + to_string(number_of_patterns), SyntheticPatterns(number_of_patterns, 6), 5000);
+    failures += CheckIndex("synthetic/long", SyntheticPatterns(130, 12), 2000);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+// File's Title: test_packed_sequence.cc
+// Description: check that PackedSequence::compare orders packed sequences exactly as
+// std::string::compare orders the strings, over all sixteen codes and every length
+// from 0 to 31, across the 30/31 packing limit, and that it defers to the strings
+// when a sequence does not pack. Then check that AvlTree<PackedSequenceMap> and
+// AvlTree<SequenceMap> built from the same records hold them in the same order.
+
+#include "avl_tree.h"
+#include "packed_sequence.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// The sixteen characters PackedSequence codes, in code order
+const char kAlphabet[] = "'ABCDGHKMNRSTVWY";
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @order: the result of a comparison.
+// Return -1, 0 or 1 as order is negative, zero or positive.
+int Sign(int order){
+    return order < 0 ? -1 : order > 0;
+}
+
+// @sequence: a sequence.
+// Return true if PackedSequence can pack it: at most 30 characters, all in the alphabet.
+bool Packable(const string &sequence){
+    return sequence.size() <= PackedSequence::MAX_LENGTH && sequence.find_first_not_of(kAlphabet) == string::npos;
+}
+
+// @sequence: a sequence.
+// Check that it packs exactly when it should, and that a packed sequence keeps
+// its length and every code and unpacks to itself.
+// Return the number of failed checks.
+int CheckPacking(const string &sequence){
+    const PackedSequence packed = PackedSequence::of(sequence);
+    if(packed.isPacked() != Packable(sequence))
+        return 1;
+    if(!packed.isPacked())
+        return packed.length() != PackedSequence::NOT_PACKED || !packed.unpack().empty();
+    int failures = packed.length() != sequence.size() || packed.unpack() != sequence;
+    for(size_t i = 0; i < sequence.size(); ++i)
+        failures += kAlphabet[packed.code(i)] != sequence[i];
+    return failures;
+}
+
+// @a: a sequence.
+// @b: another.
+// Check that PackedSequence::compare( ) agrees with std::string::compare( ) when
+// both pack and defers to the strings otherwise, and that PackedSequenceMap
+// orders them as the strings either way.
+// Return the number of failed checks.
+int CheckPair(const string &a, const string &b){
+    const int order = PackedSequence::compare(PackedSequence::of(a), PackedSequence::of(b));
+    int failures = 0;
+    if(Packable(a) && Packable(b))
+        failures += order != Sign(a.compare(b));
+    else
+        failures += order != PREFIX_UNDECIDED;
+    const PackedSequenceMap x(a, "");
+    const PackedSequenceMap y(b, "");
+    failures += (x < y) != (a < b) || (y < x) != (b < a);
+    return failures;
+}
+
+// Return sequences of every length from 0 to 31: for each, a few random ones
+// over the whole alphabet, a run of each of the sixteen characters, and every
+// prefix of a 31-character one; then the same with one character replaced by
+// one PackedSequence does not code (lower case among them), so that they do
+// not pack at any length.
+vector<string> Sequences(){
+    mt19937 random(31);
+    vector<string> sequences;
+    string longest;
+    for(size_t length = 0; length <= PackedSequence::MAX_LENGTH + 1; ++length)
+        longest += kAlphabet[random() % 16];
+    for(size_t length = 0; length <= PackedSequence::MAX_LENGTH + 1; ++length){
+        for(int i = 0; i < 8; ++i){
+            string sequence;
+            for(size_t j = 0; j < length; ++j)
+                sequence += kAlphabet[random() % 16];
+            sequences.push_back(sequence);
+        }
+        for(int code = 0; code < 16; ++code)
+            sequences.push_back(string(length, kAlphabet[code]));
+        sequences.push_back(longest.substr(0, length));
+    }
+    const size_t packable = sequences.size();
+    const string outside = "acgtnXZ-";
+    for(size_t i = 0; i < packable; i += 5)
+        if(!sequences[i].empty()){
+            string sequence = sequences[i];
+            sequence[random() % sequence.size()] = outside[random() % outside.size()];
+            sequences.push_back(sequence);
+        }
+    return sequences;
+}
+
+// Check the packing of every sequence, compare every pair of them, and compare
+// every pair of 30-character sequences that differ in one position, for every
+// position and every two codes there, so each position of hi and lo is tried
+// with all sixteen codes.
+// Return the number of failed checks.
+int CheckCompare(){
+    const vector<string> sequences = Sequences();
+    int failures = 0;
+    size_t pairs = 0;
+    for(const string &a : sequences){
+        failures += CheckPacking(a);
+        for(const string &b : sequences){
+            failures += CheckPair(a, b);
+            ++pairs;
+        }
+    }
+    for(size_t position = 0; position < PackedSequence::MAX_LENGTH; ++position)
+        for(int x = 0; x < 16; ++x)
+            for(int y = 0; y < 16; ++y){
+                string a(PackedSequence::MAX_LENGTH, 'G');
+                string b = a;
+                a[position] = kAlphabet[x];
+                b[position] = kAlphabet[y];
+                failures += CheckPair(a, b);
+                ++pairs;
+            }
+    cout<<"compare: "<<sequences.size()<<" sequences, "<<pairs<<" pairs, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @records: (acronym, sequence) records, repeats and all.
+// Insert the records into an AvlTree<PackedSequenceMap> and an AvlTree<SequenceMap>,
+// and check that their in-order traversals list the same sequences with the
+// same enzymes, and that both find the same sequences.
+// Return the number of failed checks.
+int CheckTrees(const string &name, const vector<pair<string, string>> &records){
+    AvlTree<PackedSequenceMap> packed_tree;
+    AvlTree<SequenceMap> a_tree;
+    for(const auto &record : records){
+        packed_tree.insert(PackedSequenceMap(record.second, record.first));
+        a_tree.insert(SequenceMap(record.second, record.first));
+    }
+    vector<string> packed_lines;
+    vector<string> lines;
+    packed_tree.forEach([&packed_lines](const SequenceMap &x){
+        string line = x.getRecognitionSequence();
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            line += " " + string(x.getEnzymeAcronym(i));
+        packed_lines.push_back(line);
+    });
+    a_tree.forEach([&lines](const SequenceMap &x){
+        string line = x.getRecognitionSequence();
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            line += " " + string(x.getEnzymeAcronym(i));
+        lines.push_back(line);
+    });
+    int failures = !packed_tree.isValid() || packed_lines != lines;
+    for(const auto &record : records){
+        for(const string &key : {record.second, record.second + "A", record.second.substr(1)}){
+            int packed_calls = 0;
+            int calls = 0;
+            failures += packed_tree.find(key, packed_calls) != a_tree.find(key, calls);
+        }
+    }
+    cout<<"trees/"<<name<<": "<<lines.size()<<" sequences, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<pair<string, string>> rebase;
+    ForEachRebaseRecord(db_file.contents(), [&rebase](string_view enz_acro, string_view reco_seq){
+        rebase.emplace_back(enz_acro, reco_seq);
+    });
+    // The test sequences, packed and not, mixed into one tree
+    vector<pair<string, string>> mixed = rebase;
+    for(const string &sequence : Sequences())
+        if(!sequence.empty())
+            mixed.emplace_back("Enz" + to_string(mixed.size()), sequence);
+
+    int failures = CheckCompare();
+    failures += CheckTrees("rebase", rebase);
+    failures += CheckTrees("mixed", mixed);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
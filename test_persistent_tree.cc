@@ -0,0 +1,270 @@
+// File's Title: test_persistent_tree.cc
+// Description: take snapshots of a PersistentAvlTree at random points while it keeps
+// changing, and check every snapshot against a copy of the std::map it matched when
+// taken, serially and from reader threads. Count the elements alive to check that
+// the nodes are shared, not leaked, and freed with the last version holding them.
+
+#include "persistent_avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// A SequenceMap that counts its objects alive. Every node holds one element,
+// so between two changes the count is the number of nodes the versions hold.
+class CountedSequenceMap : public SequenceMap{
+  public:
+    CountedSequenceMap(std::string_view a_rec_seq, std::string_view an_enz_acro)
+        : SequenceMap(a_rec_seq, an_enz_acro){ ++live_; }
+    CountedSequenceMap(const CountedSequenceMap &rhs) : SequenceMap(rhs){ ++live_; }
+    CountedSequenceMap(CountedSequenceMap &&rhs) : SequenceMap(std::move(rhs)){ ++live_; }
+    CountedSequenceMap &operator=(const CountedSequenceMap &rhs) = default;
+    CountedSequenceMap &operator=(CountedSequenceMap &&rhs) = default;
+    ~CountedSequenceMap(){ --live_; }
+
+    // return the number of objects alive, on every thread
+    static long live(){
+        return live_.load();
+    }
+
+  private:
+    inline static std::atomic<long> live_{0};
+};
+
+// The same inline prefix as SequenceMap
+template <>
+struct KeyPrefixTraits<CountedSequenceMap> : KeyPrefixTraits<SequenceMap>{ };
+
+namespace {
+
+typedef PersistentAvlTree<CountedSequenceMap> Tree;
+
+// The keys a version must hold, each with its enzyme acronyms in order.
+typedef map<string, vector<string>> Model;
+
+// A snapshot, what it held when taken, and its version.
+struct Snapshot{
+    Tree a_tree;
+    Model model;
+    uint64_t version;
+};
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @a_tree: a version under test.
+// @model: what it must hold.
+// Return true if the version is a valid AVL tree holding exactly the keys of
+// model, with the same enzymes in the same order.
+bool Matches(const Tree &a_tree, const Model &model){
+    if(!a_tree.isValid() || size_t(a_tree.numberOfNodes()) != model.size() || a_tree.isEmpty() != model.empty())
+        return false;
+    auto expected = model.begin();
+    bool same = true;
+    a_tree.forEach([&](const SequenceMap &x){
+        if(expected == model.end() || x.getRecognitionSequence() != expected->first
+           || x.getEnzymeCount() != expected->second.size()){
+            same = false;
+            return;
+        }
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            if(x.getEnzymeAcronym(i) != expected->second[i])
+                same = false;
+        ++expected;
+    });
+    return same && expected == model.end();
+}
+
+// @a_tree: a tree.
+// @model: what it holds, kept up to date.
+// @keys: the keys to draw from.
+// @tag: the enzyme acronym of the inserts.
+// @random: the generator.
+// Insert or remove one random key, checking find() and version() on the way.
+// Return the number of failed checks.
+int Change(Tree &a_tree, Model &model, const vector<string> &keys, const string &tag, mt19937 &random){
+    const string &key = keys[random() % keys.size()];
+    const uint64_t version = a_tree.version();
+    int find_recursive_call = 0;
+    int failures = a_tree.find(key, find_recursive_call) != int(model.count(key));
+    if(random() % 5 < 3){
+        a_tree.insert(CountedSequenceMap(key, tag));
+        model[key].push_back(tag);
+        failures += a_tree.version() != version + 1;
+    }
+    else{
+        const bool present = model.erase(key) == 1;
+        a_tree.remove(CountedSequenceMap(key, ""));
+        failures += a_tree.version() != version + present;
+    }
+    return failures;
+}
+
+// @a_tree: the tree.
+// @snapshots: its live snapshots.
+// @live_before: the elements alive before the tree was made.
+// Return true if the elements alive are as many as the nodes of the tree, at
+// least, and as many as the nodes of every version together, at most.
+bool LiveInBounds(const Tree &a_tree, const vector<Snapshot> &snapshots, long live_before){
+    long most = a_tree.numberOfNodes();
+    for(const Snapshot &snapshot : snapshots)
+        most += snapshot.a_tree.numberOfNodes();
+    const long live = CountedSequenceMap::live() - live_before;
+    return live >= a_tree.numberOfNodes() && live <= most;
+}
+
+// @name: the name of the key set, for the report.
+// @keys: the keys to draw from.
+// @steps: the number of random steps.
+// Change the tree at random and take snapshots at random points, each way a
+// version can be taken: snapshot(), the copy constructor and assignment.
+// At other points drop a random snapshot, or copy one and change the copy,
+// which must leave the snapshot alone. Check the tree after every step and
+// every snapshot every 500 steps, each against its model and its version.
+// Last, drop the snapshots in random order; the tree must then hold every
+// element alive, and emptying it must free them all.
+// Return the number of failed checks.
+int CheckSnapshots(const string &name, const vector<string> &keys, int steps){
+    const long live_before = CountedSequenceMap::live();
+    mt19937 random(steps);
+    int failures = 0;
+    size_t taken = 0;
+    {
+        Tree a_tree;
+        Model model;
+        vector<Snapshot> snapshots;
+        for(int step = 0; step < steps; ++step){
+            const int operation = random() % 16;
+            if(operation < 13){
+                failures += Change(a_tree, model, keys, "E" + to_string(step), random);
+            }
+            else if(operation == 13){
+                Snapshot snapshot{Tree(), model, a_tree.version()};
+                if(taken % 3 == 0)
+                    snapshot.a_tree = a_tree.snapshot();
+                else if(taken % 3 == 1)
+                    snapshot.a_tree = Tree(a_tree);
+                else
+                    snapshot.a_tree = a_tree;
+                snapshots.push_back(std::move(snapshot));
+                ++taken;
+            }
+            else if(!snapshots.empty() && operation == 14){
+                swap(snapshots[random() % snapshots.size()], snapshots.back());
+                snapshots.pop_back();
+                failures += !LiveInBounds(a_tree, snapshots, live_before);
+            }
+            else if(!snapshots.empty()){
+                const Snapshot &snapshot = snapshots[random() % snapshots.size()];
+                Tree branch = snapshot.a_tree;
+                Model branch_model = snapshot.model;
+                for(int i = 0; i < 20; ++i)
+                    failures += Change(branch, branch_model, keys, "Branch", random);
+                failures += !Matches(branch, branch_model) || !Matches(snapshot.a_tree, snapshot.model);
+            }
+            if(step % 5000 == 4999){
+                a_tree.makeEmpty();
+                model.clear();
+            }
+            failures += !Matches(a_tree, model);
+            if(step % 500 == 499)
+                for(const Snapshot &snapshot : snapshots)
+                    failures += !Matches(snapshot.a_tree, snapshot.model) || snapshot.a_tree.version() != snapshot.version;
+        }
+        shuffle(snapshots.begin(), snapshots.end(), random);
+        while(!snapshots.empty()){
+            snapshots.pop_back();
+            failures += !LiveInBounds(a_tree, snapshots, live_before);
+        }
+        if(CountedSequenceMap::live() - live_before != a_tree.numberOfNodes()){
+            cout<<"snapshots/"<<name<<": "<<CountedSequenceMap::live() - live_before<<" elements alive, "
+                <<a_tree.numberOfNodes()<<" nodes in the tree"<<endl;
+            ++failures;
+        }
+        a_tree.makeEmpty();
+    }
+    if(CountedSequenceMap::live() != live_before){
+        cout<<"snapshots/"<<name<<": "<<CountedSequenceMap::live() - live_before<<" elements leaked"<<endl;
+        ++failures;
+    }
+    cout<<"snapshots/"<<name<<": "<<steps<<" steps, "<<taken<<" snapshots, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @keys: the keys to draw from.
+// @readers: the number of reader threads.
+// Hand a snapshot to each reader thread, which copies it and checks the copy
+// again and again, while this thread changes the tree, and drops its own
+// reference, before starting the next reader. Once the readers are done, the
+// tree must hold every element alive.
+// Return the number of failed checks.
+int CheckReaders(const vector<string> &keys, int readers){
+    const long live_before = CountedSequenceMap::live();
+    mt19937 random(readers);
+    atomic<int> failures{0};
+    {
+        Tree a_tree;
+        Model model;
+        for(size_t i = 0; i < keys.size() / 2; ++i)
+            failures += Change(a_tree, model, keys, "E", random);
+        vector<thread> threads;
+        for(int reader = 0; reader < readers; ++reader){
+            threads.emplace_back([snapshot = a_tree.snapshot(), model, &failures](){
+                for(int round = 0; round < 50; ++round){
+                    Tree copy = snapshot;
+                    if(!Matches(copy, model))
+                        ++failures;
+                }
+            });
+            for(int i = 0; i < 500; ++i)
+                failures += Change(a_tree, model, keys, "R" + to_string(reader), random);
+        }
+        for(thread &reader : threads)
+            reader.join();
+        threads.clear();
+        failures += !Matches(a_tree, model) || CountedSequenceMap::live() - live_before != a_tree.numberOfNodes();
+    }
+    failures += CountedSequenceMap::live() != live_before;
+    cout<<"readers: "<<readers<<" threads, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<string> rebase_keys;
+    ForEachRebaseRecord(db_file.contents(), [&rebase_keys](string_view, string_view reco_seq){
+        rebase_keys.emplace_back(reco_seq);
+    });
+    // A few keys, for merges and removes that hit, and many, for deep trees
+    vector<string> few_keys(rebase_keys.begin(), rebase_keys.begin() + 40);
+
+    int failures = CheckSnapshots("few", few_keys, 20000);
+    failures += CheckSnapshots("rebase", rebase_keys, 20000);
+    failures += CheckReaders(rebase_keys, 4);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
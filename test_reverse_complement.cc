@@ -0,0 +1,164 @@
+// File's Title: test_reverse_complement.cc
+// Description: check the SSSE3 reverse-complement kernel against the scalar one on every
+// length from 0 to 80 and every byte value, and check that canonical keys and
+// CanonicalSequenceMap lookups round-trip on the REBASE recognition sequences.
+
+#include "avl_tree.h"
+#include "canonical_sequence_map.h"
+#include "rebase_loader.h"
+#include "reverse_complement.h"
+#include "sequence_map.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+const size_t kMaxLength = 80;
+const size_t kGuard = 16;   // Bytes either side of the output that no kernel may touch
+
+#ifdef REVERSE_COMPLEMENT_SSSE3
+// @sequence: the input.
+// Run both kernels on sequence, writing into guarded buffers.
+// Return true if they write the same bytes and nothing outside the output.
+bool SameAsScalar(const string &sequence){
+    const size_t length = sequence.size();
+    string scalar(length + 2 * kGuard, '#');
+    string vector(length + 2 * kGuard, '#');
+    ReverseComplementScalar(sequence.data(), length, &scalar[kGuard]);
+    ReverseComplementSsse3(sequence.data(), length, &vector[kGuard]);
+    return scalar == vector && scalar.compare(0, kGuard, string(kGuard, '#')) == 0
+        && scalar.compare(kGuard + length, kGuard, string(kGuard, '#')) == 0;
+}
+
+// Compare the kernels on every length from 0 to kMaxLength, so every split
+// into 16-character blocks and a scalar tail is met, at every offset of the
+// input within a 16-byte line, with IUPAC letters of either case and cut marks,
+// and with bytes of every value, the letters' neighbours 0x3F, 0x5B, 0x60, 0x7B
+// and the high half included.
+// Return the number of failed checks.
+int CheckKernels(){
+    mt19937 random(kMaxLength);
+    const string iupac = "ACGTURYSWKMBDHVNacgturyswkmbdhvn'";
+    int failures = 0;
+    int checks = 0;
+    string buffer(kMaxLength + 16, '\0');
+    for(size_t length = 0; length <= kMaxLength; ++length){
+        for(size_t offset = 0; offset < 16; ++offset){
+            for(int alphabet = 0; alphabet < 2; ++alphabet){
+                for(size_t i = 0; i < length; ++i)
+                    buffer[offset + i] = alphabet == 0 ? iupac[random() % iupac.size()] : char(random() % 256);
+                failures += !SameAsScalar(buffer.substr(offset, length));
+                ++checks;
+            }
+        }
+    }
+    // Every byte value at every place in a block and in the tail
+    for(int c = 0; c < 256; ++c){
+        for(size_t i = 0; i < 40; ++i){
+            string sequence(40, 'A');
+            sequence[i] = char(c);
+            failures += !SameAsScalar(sequence);
+            ++checks;
+        }
+    }
+    string every_byte;
+    for(int c = 0; c < 256; ++c)
+        every_byte += char(c);
+    failures += !SameAsScalar(every_byte);
+    ++checks;
+    cout<<"kernels: "<<checks<<" checks, lengths 0 to "<<kMaxLength<<", "<<failures<<" failures"<<endl;
+    return failures;
+}
+#endif
+
+// @records: every (recognition sequence, enzyme acronym) pair of the database.
+// Check that reverse complementing twice gives the sequence back, that both
+// strands of a sequence have the same canonical key, with strands that say
+// which one it is, and that FindBothStrands() on either strand of a sequence
+// finds what a scan of the records does: every enzyme whose sequence is the
+// query, on '+', and every enzyme whose sequence is its reverse complement, on
+// '-'. Some enzymes are listed on both strands, and are found on both.
+// Return the number of failed checks.
+int CheckCanonical(const vector<pair<string, string>> &records){
+    AvlTree<CanonicalSequenceMap> canonical_tree;
+    for(const auto &record : records)
+        canonical_tree.insert(CanonicalSequenceMap(record.first, record.second));
+    int failures = 0;
+    for(const auto &record : records){
+        const string &sequence = record.first;
+        const string reverse = ReverseComplement(sequence);
+        if(ReverseComplement(reverse) != sequence)
+            ++failures;
+        const CanonicalKey key = Canonicalize(sequence);
+        const CanonicalKey reverse_key = Canonicalize(reverse);
+        if(key.sequence != reverse_key.sequence || key.sequence > sequence || key.sequence > reverse)
+            ++failures;
+        if((key.strand == '+' ? key.sequence : ReverseComplement(key.sequence)) != sequence)
+            ++failures;
+        for(const string &query : {sequence, reverse}){
+            const string query_reverse = ReverseComplement(query);
+            vector<pair<string, char>> found, expected;
+            const int count = FindBothStrands(canonical_tree, query, [&found](string_view acronym, char strand){
+                found.emplace_back(string(acronym), strand);
+            });
+            for(const auto &other : records){
+                if(other.first == query)
+                    expected.emplace_back(other.second, '+');
+                else if(other.first == query_reverse)
+                    expected.emplace_back(other.second, '-');
+            }
+            sort(found.begin(), found.end());
+            sort(expected.begin(), expected.end());
+            if(found != expected || size_t(count) != expected.size())
+                ++failures;
+        }
+    }
+    cout<<"canonical: "<<records.size()<<" sequences, "<<canonical_tree.numberOfNodes()<<" canonical keys, "
+        <<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<pair<string, string>> records;
+    ForEachRebaseRecord(db_file.contents(), [&records](string_view enz_acro, string_view reco_seq){
+        records.emplace_back(string(reco_seq), string(enz_acro));
+    });
+
+    int failures = 0;
+#ifdef REVERSE_COMPLEMENT_SSSE3
+    if(ReverseComplementIsVectorized())
+        failures += CheckKernels();
+    else
+        cout<<"kernels: no SSSE3 on this CPU, skipped"<<endl;
+#else
+    cout<<"kernels: no SSSE3 kernel on this target, skipped"<<endl;
+#endif
+    failures += CheckCanonical(records);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
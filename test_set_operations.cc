@@ -0,0 +1,345 @@
+// File's Title: test_set_operations.cc
+// Description: check split, join, unionWith, intersect and difference, serially and
+// on a thread pool, against a std::map of the keys and their enzymes, with the AVL
+// invariants, sizes, depth sums and parent pointers checked after every operation,
+// and check that trees that share or adopted node memory stay usable.
+
+#include "avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// The keys a tree must hold, each with its enzyme acronyms in order.
+typedef map<string, vector<string>> Model;
+
+enum Operation { UNION, INTERSECTION, DIFFERENCE };
+const char *const kOperationNames[] = {"union", "intersect", "difference"};
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @a_tree: the tree under test.
+// @model: what the tree must hold.
+// Return true if isValid() accepts the tree, which checks the order, the
+// balance, the heights, sizes, depth sums and parent pointers, and the tree
+// holds exactly the keys of model, with the same enzymes in the same order.
+bool Matches(const AvlTree<SequenceMap> &a_tree, const Model &model){
+    if(!a_tree.isValid() || size_t(a_tree.numberOfNodes()) != model.size() || a_tree.isEmpty() != model.empty())
+        return false;
+    auto expected = model.begin();
+    bool same = true;
+    a_tree.forEach([&](const SequenceMap &x){
+        if(expected == model.end() || x.getRecognitionSequence() != expected->first
+           || x.getEnzymeCount() != expected->second.size()){
+            same = false;
+            return;
+        }
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            if(x.getEnzymeAcronym(i) != expected->second[i])
+                same = false;
+        ++expected;
+    });
+    return same && expected == model.end();
+}
+
+// @universe: the distinct keys to draw from.
+// @number_of_keys: the number of keys of the tree, at most universe.size().
+// @tag: the prefix of the enzyme acronyms, telling the trees apart.
+// @random: the generator.
+// Fill an empty tree and its model with number_of_keys keys drawn at random,
+// inserted one by one or bulk loaded.
+void RandomTree(const vector<string> &universe, size_t number_of_keys, const string &tag, mt19937_64 &random,
+                AvlTree<SequenceMap> &a_tree, Model &model){
+    vector<string> keys(universe);
+    shuffle(keys.begin(), keys.end(), random);
+    keys.resize(number_of_keys);
+    vector<SequenceMap> items;
+    for(size_t i = 0; i < keys.size(); ++i){
+        const string acronym = tag + to_string(i);
+        items.push_back(SequenceMap(keys[i], acronym));
+        model[keys[i]].push_back(acronym);
+    }
+    if(random() % 2)
+        a_tree.bulkLoad(items.begin(), items.end());
+    else
+        for(const SequenceMap &item : items)
+            a_tree.insert(item);
+}
+
+// @a_tree: a tree.
+// @model: what it holds, kept up to date.
+// @universe: the keys to draw from.
+// @steps: the number of random inserts and removes.
+// @random: the generator.
+// Insert and remove random keys and check find() and remove() against the model,
+// so that nodes are allocated and freed in whatever memory the tree now uses.
+// Return the number of failed checks, the final comparison included.
+int Mutate(AvlTree<SequenceMap> &a_tree, Model &model, const vector<string> &universe, int steps,
+           mt19937_64 &random){
+    int failures = 0;
+    for(int step = 0; step < steps; ++step){
+        const string &key = universe[random() % universe.size()];
+        if(a_tree.find(key) != int(model.count(key)))
+            ++failures;
+        if(random() % 2){
+            a_tree.insert(SequenceMap(key, "Mut"));
+            model[key].push_back("Mut");
+        }
+        else if(a_tree.remove(key) != int(model.erase(key))){
+            ++failures;
+        }
+    }
+    return failures + !Matches(a_tree, model);
+}
+
+// @a: the model of the tree operated on.
+// @b: the model of the other tree.
+// @operation: the operation.
+// Return the model of the result: a key of both keeps the enzymes of a then
+// those of b, as Merge() appends them.
+Model Expected(const Model &a, const Model &b, Operation operation){
+    Model result;
+    for(const auto &item : a){
+        auto other = b.find(item.first);
+        if(operation == DIFFERENCE && other == b.end())
+            result.insert(item);
+        else if(operation != DIFFERENCE && (operation == UNION || other != b.end())){
+            vector<string> &acronyms = result[item.first] = item.second;
+            if(other != b.end())
+                acronyms.insert(acronyms.end(), other->second.begin(), other->second.end());
+        }
+    }
+    if(operation == UNION)
+        for(const auto &item : b)
+            result.insert(item);
+    return result;
+}
+
+// @a_tree: the tree operated on.
+// @rhs: the other tree, emptied by the operation.
+// @operation: the operation.
+// @workers: the thread pool, or nullptr to run serially.
+void Apply(AvlTree<SequenceMap> &a_tree, AvlTree<SequenceMap> &rhs, Operation operation, ThreadPool *workers){
+    switch(operation){
+      case UNION:
+        workers ? a_tree.unionWith(std::move(rhs), *workers) : a_tree.unionWith(std::move(rhs));
+        break;
+      case INTERSECTION:
+        workers ? a_tree.intersect(std::move(rhs), *workers) : a_tree.intersect(std::move(rhs));
+        break;
+      case DIFFERENCE:
+        workers ? a_tree.difference(std::move(rhs), *workers) : a_tree.difference(std::move(rhs));
+        break;
+    }
+}
+
+// @name: the name of the case, for the report.
+// @universe: the keys to draw from; the smaller it is, the more the trees overlap.
+// @sizes: the sizes of the two trees, one pair per round.
+// @workers: the thread pool, or nullptr to run serially.
+// For every round and operation, build two random trees, apply the operation,
+// and check the result, that the other tree is left empty and valid, and that
+// both trees stay usable: the result frees nodes that lived in the other
+// tree's memory, and the other tree allocates afresh.
+// Return the number of failed checks.
+int CheckSetOperations(const string &name, const vector<string> &universe,
+                       const vector<pair<size_t, size_t>> &sizes, ThreadPool *workers){
+    mt19937_64 random(universe.size() + sizes.size());
+    int failures = 0;
+    int checks = 0;
+    for(const auto &size : sizes){
+        for(Operation operation : {UNION, INTERSECTION, DIFFERENCE}){
+            AvlTree<SequenceMap> a_tree;
+            AvlTree<SequenceMap> rhs;
+            Model a_model;
+            Model rhs_model;
+            RandomTree(universe, size.first, "A", random, a_tree, a_model);
+            RandomTree(universe, size.second, "B", random, rhs, rhs_model);
+            Model expected = Expected(a_model, rhs_model, operation);
+            Apply(a_tree, rhs, operation, workers);
+            Model empty;
+            if(!Matches(a_tree, expected) || !Matches(rhs, empty)){
+                cout<<name<<": "<<kOperationNames[operation]<<" of "<<size.first<<" and "<<size.second
+                    <<" keys differs"<<endl;
+                ++failures;
+            }
+            failures += Mutate(a_tree, expected, universe, 200, random);
+            failures += Mutate(rhs, empty, universe, 200, random);
+            ++checks;
+        }
+    }
+    cout<<name<<": "<<checks<<" operations"<<(workers ? " on a thread pool, " : ", ")<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @model: the keys of a tree.
+// @x: the key split around.
+// Return the keys less than x, removing them from model.
+Model SplitModel(Model &model, const string &x){
+    Model less(model.begin(), model.lower_bound(x));
+    model.erase(model.begin(), model.lower_bound(x));
+    return less;
+}
+
+// @universe: the keys to draw from.
+// @sizes: the sizes of the trees, one per round.
+// Split random trees around keys in them, keys not in them, and keys before and
+// after all of them, and check both halves. Then either join them back and
+// compare with the tree split, or keep mutating them, sharing memory, destroy
+// one of them, and keep mutating the other.
+// Return the number of failed checks.
+int CheckSplitJoin(const vector<string> &universe, const vector<size_t> &sizes){
+    mt19937_64 random(sizes.size());
+    int failures = 0;
+    int checks = 0;
+    for(size_t size : sizes){
+        for(int round = 0; round < 8; ++round){
+            auto less = make_unique<AvlTree<SequenceMap>>();
+            auto greater = make_unique<AvlTree<SequenceMap>>();
+            Model greater_model;
+            RandomTree(universe, size, "A", random, *less, greater_model);
+            const Model whole = greater_model;
+            string x = universe[random() % universe.size()];
+            if(round == 0)
+                x = "";
+            else if(round == 1)
+                x = "~";
+            else if(round == 2 && !whole.empty())
+                x = whole.begin()->first;
+            // A filled greater tree is emptied first
+            greater->insert(SequenceMap("GAATTC", "EcoRI"));
+            less->split(x, *greater);
+            Model less_model = SplitModel(greater_model, x);
+            if(!Matches(*less, less_model) || !Matches(*greater, greater_model)){
+                cout<<"split: "<<size<<" keys around "<<x<<" differs"<<endl;
+                ++failures;
+            }
+            ++checks;
+            if(round % 2 == 0){
+                less->join(std::move(*greater));
+                Model empty;
+                if(!Matches(*less, whole) || !Matches(*greater, empty)){
+                    cout<<"join: "<<size<<" keys around "<<x<<" differs"<<endl;
+                    ++failures;
+                }
+                less_model = whole;
+                failures += Mutate(*greater, empty, universe, 200, random);
+                failures += Mutate(*less, less_model, universe, 200, random);
+                continue;
+            }
+            failures += Mutate(*less, less_model, universe, 300, random);
+            failures += Mutate(*greater, greater_model, universe, 300, random);
+            // Destroy either half, or empty it, and the other must not notice
+            if(round % 4 == 1){
+                swap(less, greater);
+                swap(less_model, greater_model);
+            }
+            if(round == 7){
+                less->makeEmpty();
+                less_model.clear();
+                failures += !Matches(*less, less_model);
+            }
+            else{
+                less.reset();
+            }
+            failures += Mutate(*greater, greater_model, universe, 300, random);
+            greater->makeEmpty();
+            greater_model.clear();
+            failures += Mutate(*greater, greater_model, universe, 100, random);
+        }
+    }
+
+    // The errors the header promises, leaving the trees as they were
+    AvlTree<SequenceMap> a_tree;
+    AvlTree<SequenceMap> rhs;
+    a_tree.insert(SequenceMap("GAATTC", "EcoRI"));
+    rhs.insert(SequenceMap("AAGCTT", "HindIII"));
+    bool thrown = false;
+    try{
+        a_tree.join(std::move(rhs));
+    }
+    catch(const IllegalArgumentException &){
+        thrown = true;
+    }
+    try{
+        a_tree.split("GAATTC", a_tree);
+        thrown = false;
+    }
+    catch(const IllegalArgumentException &){
+    }
+    if(!thrown || a_tree.numberOfNodes() != 1 || rhs.numberOfNodes() != 1 || !a_tree.isValid()){
+        cout<<"split: out of order join or split into itself accepted"<<endl;
+        ++failures;
+    }
+    cout<<"split: "<<checks<<" splits and joins, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @base: the REBASE recognition sequences.
+// @number_of_keys: the number of random keys to add.
+// Return the distinct keys of base and of number_of_keys random sequences of 6
+// to 12 bases, in random order.
+vector<string> Universe(const vector<string> &base, size_t number_of_keys){
+    mt19937_64 random(number_of_keys);
+    set<string> keys(base.begin(), base.end());
+    while(keys.size() < base.size() + number_of_keys){
+        string key;
+        for(size_t i = 6 + random() % 7; i > 0; --i)
+            key += "ACGT"[random() % 4];
+        keys.insert(key);
+    }
+    return vector<string>(keys.begin(), keys.end());
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    vector<string> rebase_keys;
+    ForEachRebaseRecord(db_file.contents(), [&rebase_keys](string_view, string_view reco_seq){
+        rebase_keys.emplace_back(reco_seq);
+    });
+
+    const vector<string> small = Universe(rebase_keys, 0);
+    const vector<string> large = Universe(rebase_keys, 40000);
+    // Empty, tiny, equal and lopsided trees; the large ones pass the parallel grain
+    const vector<pair<size_t, size_t>> small_sizes = {{0, 0}, {0, 10}, {10, 0}, {1, 1}, {3, 50}, {100, 100},
+                                                      {300, 300}, {small.size(), small.size()}, {small.size(), 7}};
+    const vector<pair<size_t, size_t>> large_sizes = {{20000, 20000}, {30000, 500}, {500, 30000}, {large.size(), 10000}};
+    ThreadPool pool(4);
+    int failures = 0;
+    failures += CheckSetOperations("rebase", small, small_sizes, nullptr);
+    failures += CheckSetOperations("rebase", small, small_sizes, &pool);
+    failures += CheckSetOperations("large", large, large_sizes, nullptr);
+    failures += CheckSetOperations("large", large, large_sizes, &pool);
+    failures += CheckSplitJoin(small, {0, 1, 2, 50, small.size()});
+    failures += CheckSplitJoin(large, {20000});
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
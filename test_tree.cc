@@ -5,11 +5,14 @@
 // Main file for Part2(b) of Homework 2.
 
 #include "avl_tree.h"
+#include "rebase_loader.h"
 #include "sequence_map.h"
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <fstream>
+#include <vector>
 using namespace std;
 
 namespace {
@@ -24,59 +27,36 @@ void CheckFile(const string &filename){
     }
 }
     
-// @db_line: a line from an input database.
-// Return a string of extracted portion from the db_line.
-string ExtractFromLine(string &db_line){
-    size_t break_point = db_line.find('/');
-    string extract = db_line.substr(0,break_point);
-    db_line = db_line.substr(break_point+1, db_line.length());
-    return extract;
-}
-
 // @db_filename: an input database filename.
 // @a_tree: an input tree of the type TreeType. It is assumed to be empty.
 // Create an AVL tree.
 template <typename TreeType>
 void ConstructTree(const string &db_filename,TreeType &a_tree){
     CheckFile(db_filename);
-    ifstream in_file(db_filename);
-    
-    string db_line, enz_acro, reco_seq;
-    
-    //skip over the header
-    for(size_t i = 0; i < 10; ++i){
-        getline(in_file, db_line);
-    }
-    
-    while(getline(in_file, db_line)){
-        if(db_line.empty())
-            continue;
-        enz_acro = ExtractFromLine(db_line);
-        while(db_line.length() > 2){
-            reco_seq = ExtractFromLine(db_line);
-            SequenceMap new_sequence_map(reco_seq, enz_acro);
-            a_tree.insert(new_sequence_map);
-        }
-    }
-    in_file.close();
+    MappedFile db_file(db_filename);
+    ForEachRebaseRecord(db_file.contents(), [&a_tree](string_view enz_acro, string_view reco_seq){
+        a_tree.insert(SequenceMap(reco_seq, enz_acro));
+    });
 }
 
 // @seq_filename: an input sequences filename.
 // @a_tree: an input tree of the type TreeType. It is assumed to be empty.
-// Test the function find().
+// Test the function find(), looking the sequences up in batches with findBatch().
 template <typename TreeType>
 void TestFind(const string &seq_filename, TreeType &a_tree){
     CheckFile(seq_filename);
     ifstream seq_file(seq_filename);
+    vector<string> seq_lines;
     string seq_line;
-    int find_recursive_call = 0;
-    int successful_query = 0;
-    float number_of_query = 0;
-    while(getline(seq_file, seq_line)){
-        successful_query += a_tree.find(seq_line, find_recursive_call);
-        ++number_of_query;
-    }
+    while(getline(seq_file, seq_line))
+        seq_lines.push_back(seq_line);
     seq_file.close();
+
+    vector<string_view> keys(seq_lines.begin(), seq_lines.end());
+    vector<int> found(keys.size());
+    int find_recursive_call = 0;
+    int successful_query = a_tree.findBatch(keys.data(), keys.size(), found.data(), find_recursive_call);
+    float number_of_query = keys.size();
     
     cout<<"4a: "<<successful_query<<endl;
     cout<<"4b: "<<find_recursive_call/number_of_query<<endl;
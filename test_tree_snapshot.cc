@@ -0,0 +1,234 @@
+// File's Title: test_tree_snapshot.cc
+// Description: write the REBASE tree as a snapshot, map it back and compare every query
+// with the tree, then check that the loader rejects damaged files: truncated ones,
+// a flipped checksum or body byte, a wrong magic or version, and, with the checksum
+// made right again, offsets and indices past the end of their sections.
+
+#include "avl_tree.h"
+#include "rebase_loader.h"
+#include "sequence_map.h"
+#include "tree_snapshot.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+const char kSnapshotFilename[] = "test_tree_snapshot.snap";
+
+// Check the opening of file.
+// If failed, exist.
+void CheckFile(const MappedFile &db_file){
+    if(!db_file.isOpen()){
+        cerr<<"File opening failed!"<<endl;
+        exit(1);
+    }
+}
+
+// @print: anything that prints to cout.
+// Return what it printed.
+string Printed(const function<void()> &print){
+    ostringstream out;
+    streambuf *old_buffer = cout.rdbuf(out.rdbuf());
+    print();
+    cout.rdbuf(old_buffer);
+    return out.str();
+}
+
+// @filename: a file.
+// Return its bytes.
+string ReadBytes(const string &filename){
+    ifstream in_file(filename, ios::binary);
+    ostringstream bytes;
+    bytes<<in_file.rdbuf();
+    return bytes.str();
+}
+
+// @bytes: the contents of a snapshot file.
+// Write them to the test file and return true if TreeSnapshot accepts it.
+bool Loads(const string &bytes){
+    {
+        ofstream out_file(kSnapshotFilename, ios::binary | ios::trunc);
+        out_file.write(bytes.data(), bytes.size());
+    }
+    return TreeSnapshot(kSnapshotFilename).isOpen();
+}
+
+// @bytes: the contents of a snapshot file.
+// Return its header.
+SnapshotHeader Header(const string &bytes){
+    SnapshotHeader header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    return header;
+}
+
+// @bytes: the contents of a snapshot file.
+// Recompute the checksum over the body, so only the structural checks are left
+// to catch what was changed in it.
+void FixChecksum(string &bytes){
+    SnapshotHeader header = Header(bytes);
+    header.checksum = SnapshotChecksum(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+    memcpy(&bytes[0], &header, sizeof(header));
+}
+
+// @bytes: the contents of a snapshot file.
+// @offset: a byte offset into them.
+// @value: the 32-bit value to store there.
+void Put32(string &bytes, size_t offset, uint32_t value){
+    memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+// @name: the name of the tree, for the report.
+// @a_tree: a tree.
+// @absent: keys that are not in the tree.
+// Snapshot the tree, map it back and compare numberOfNodes(), forEach(),
+// and contains(), find() and findRecoSeq() of every key and every absent key.
+// Return the number of failed checks.
+template <typename TreeType>
+int CheckRoundTrip(const string &name, const TreeType &a_tree, const vector<string> &absent){
+    if(!WriteTreeSnapshot(a_tree, kSnapshotFilename)){
+        cout<<"round trip/"<<name<<": writing failed"<<endl;
+        return 1;
+    }
+    const TreeSnapshot snapshot(kSnapshotFilename);
+    if(!snapshot.isOpen() || snapshot.numberOfNodes() != a_tree.numberOfNodes()){
+        cout<<"round trip/"<<name<<": not loaded"<<endl;
+        return 1;
+    }
+    int failures = 0;
+    vector<string> expected;
+    a_tree.forEach([&expected](const SequenceMap &x){
+        string line = x.getRecognitionSequence();
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            line += " " + string(x.getEnzymeAcronym(i));
+        expected.push_back(line);
+    });
+    vector<string> found;
+    vector<string> keys;
+    snapshot.forEach([&found, &keys](string_view sequence, const vector<string_view> &acronyms){
+        string line(sequence);
+        for(string_view acronym : acronyms)
+            line += " " + string(acronym);
+        found.push_back(line);
+        keys.emplace_back(sequence);
+    });
+    failures += found != expected;
+    keys.insert(keys.end(), absent.begin(), absent.end());
+    for(const string &key : keys){
+        int visited = 0;
+        int tree_calls = 0;
+        const int in_tree = a_tree.find(key, tree_calls);
+        if(snapshot.find(key, visited) != in_tree || snapshot.contains(key) != bool(in_tree) || visited <= 0)
+            ++failures;
+        if(Printed([&](){ snapshot.findRecoSeq(key); }) != Printed([&](){ a_tree.findRecoSeq(key); }))
+            ++failures;
+    }
+    cout<<"round trip/"<<name<<": "<<keys.size()<<" queries, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+// @good: the contents of a valid snapshot of a nonempty tree.
+// Change it in every way the loader must catch, and check each is rejected,
+// and that the file itself still loads.
+// Return the number of failed checks.
+int CheckRejects(const string &good){
+    const SnapshotHeader header = Header(good);
+    const size_t nodes = sizeof(SnapshotHeader);
+    const size_t enzymes = nodes + header.node_count * sizeof(SnapshotNode);
+    const size_t offsets = enzymes + header.enzyme_count * sizeof(uint32_t);
+    struct Damage{
+        const char *name;
+        function<void(string &)> apply;
+    };
+    const vector<Damage> damages = {
+        {"empty file", [](string &bytes){ bytes.clear(); }},
+        {"half a header", [](string &bytes){ bytes.resize(sizeof(SnapshotHeader) / 2); }},
+        {"header only", [](string &bytes){ bytes.resize(sizeof(SnapshotHeader)); }},
+        {"last byte cut", [](string &bytes){ bytes.pop_back(); }},
+        {"truncated nodes", [offsets](string &bytes){ bytes.resize(offsets - 2); }},
+        {"a byte too many", [](string &bytes){ bytes.push_back('\0'); FixChecksum(bytes); }},
+        {"checksum byte flipped", [](string &bytes){ bytes[offsetof(SnapshotHeader, checksum)] ^= 0x01; }},
+        {"body byte flipped", [](string &bytes){ bytes[bytes.size() - 1] ^= 0x20; }},
+        {"wrong magic", [](string &bytes){ bytes[0] = 'X'; }},
+        {"wrong version", [](string &bytes){ Put32(bytes, offsetof(SnapshotHeader, version), SNAPSHOT_VERSION + 1); }},
+        {"node count past the end", [](string &bytes){
+            Put32(bytes, offsetof(SnapshotHeader, node_count), Header(bytes).node_count + 1); }},
+        {"string bytes past the end", [](string &bytes){
+            SnapshotHeader changed = Header(bytes);
+            changed.string_bytes += 1u << 20;
+            memcpy(&bytes[0], &changed, sizeof(changed)); }},
+        {"last offset past the strings", [offsets, header](string &bytes){
+            Put32(bytes, offsets + header.string_count * sizeof(uint32_t), uint32_t(header.string_bytes) + 1);
+            FixChecksum(bytes); }},
+        {"offset past the end of the file", [offsets](string &bytes){
+            Put32(bytes, offsets + sizeof(uint32_t), 0x7FFFFFFF); FixChecksum(bytes); }},
+        {"first offset not zero", [offsets](string &bytes){ Put32(bytes, offsets, 1); FixChecksum(bytes); }},
+        {"enzyme id past the strings", [enzymes, header](string &bytes){
+            Put32(bytes, enzymes, header.string_count); FixChecksum(bytes); }},
+        {"sequence id past the strings", [nodes](string &bytes){
+            Put32(bytes, nodes + offsetof(SnapshotNode, sequence), 0xFFFFFFF0); FixChecksum(bytes); }},
+        {"enzymes past the end", [nodes, header](string &bytes){
+            Put32(bytes, nodes + offsetof(SnapshotNode, first_enzyme), header.enzyme_count); FixChecksum(bytes); }},
+        {"enzyme count wrapping around", [nodes](string &bytes){
+            Put32(bytes, nodes + offsetof(SnapshotNode, enzyme_count), 0xFFFFFFFF); FixChecksum(bytes); }},
+        {"child past the nodes", [nodes, header](string &bytes){
+            Put32(bytes, nodes + offsetof(SnapshotNode, left), header.node_count); FixChecksum(bytes); }},
+        {"child pointing at itself", [nodes](string &bytes){
+            Put32(bytes, nodes + sizeof(SnapshotNode) + offsetof(SnapshotNode, right), 1); FixChecksum(bytes); }},
+        {"child pointing at the root", [nodes](string &bytes){
+            Put32(bytes, nodes + offsetof(SnapshotNode, right), 0); FixChecksum(bytes); }},
+    };
+    int failures = 0;
+    if(!Loads(good)){
+        cout<<"rejects: the good snapshot does not load"<<endl;
+        ++failures;
+    }
+    for(const Damage &damage : damages){
+        string bytes = good;
+        damage.apply(bytes);
+        if(Loads(bytes)){
+            cout<<"rejects: "<<damage.name<<" accepted"<<endl;
+            ++failures;
+        }
+    }
+    cout<<"rejects: "<<damages.size()<<" damaged files, "<<failures<<" failures"<<endl;
+    return failures;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv) {
+    if (argc != 2) {
+        cout << "Usage: " << argv[0] << " <databasefilename>" << endl;
+        return 0;
+    }
+    MappedFile db_file(argv[1]);
+    CheckFile(db_file);
+    AvlTree<SequenceMap> a_tree;
+    ForEachRebaseRecord(db_file.contents(), [&a_tree](string_view enz_acro, string_view reco_seq){
+        a_tree.insert(SequenceMap(reco_seq, enz_acro));
+    });
+    // Below the smallest key, above the largest, between keys, a prefix and an extension of a key
+    const vector<string> absent = {"", "A", "AAAAAAAAAAAA", "TTTTTTTTTTTTTTTT", "zzz", "GAATT", "GAATTCA", "NNNNNN"};
+
+    int failures = CheckRoundTrip("rebase", a_tree, absent);
+    AvlTree<SequenceMap> one;
+    one.insert(SequenceMap("GAATTC", "EcoRI"));
+    failures += CheckRoundTrip("one", one, absent);
+    failures += CheckRoundTrip("empty", AvlTree<SequenceMap>(), absent);
+    WriteTreeSnapshot(a_tree, kSnapshotFilename);
+    failures += CheckRejects(ReadBytes(kSnapshotFilename));
+    remove(kSnapshotFilename);
+    cout<<(failures == 0 ? "PASS" : "FAIL")<<endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+// File's Title: thread_pool.h
+// Description: a work-stealing thread pool, and task groups whose waiting thread
+// runs queued tasks instead of blocking.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool class
+//
+// CONSTRUCTION: with the number of worker threads (default: one per core)
+//
+// ******************PUBLIC OPERATIONS*********************
+// size_t size( )              --> Return the number of worker threads
+// void submit( task )         --> Queue task to run on some worker
+// bool runPendingTask( )      --> Run one queued task on the calling thread, if any
+//
+// Every worker owns a queue. A task submitted from a worker goes to the back of
+// that worker's queue, and the worker takes its own tasks from the back, newest
+// first, while its cache is still warm. A worker whose queue is empty steals the
+// oldest task from the front of another queue. Tasks submitted from outside the
+// pool are dealt round-robin over the queues. The destructor runs every task
+// still queued, then joins the workers. A task passed to submit( ) must not
+// throw; TaskGroup catches exceptions for its tasks.
+
+class ThreadPool{
+  public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()){
+        if(threads == 0)
+            threads = 1;
+        for(size_t i = 0; i < threads; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+        for(size_t i = 0; i < threads; ++i)
+            workers_.emplace_back([this, i](){ WorkerLoop(i); });
+    }
+
+    ThreadPool(const ThreadPool &rhs) = delete;
+    ThreadPool &operator=(const ThreadPool &rhs) = delete;
+
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(sleep_lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for(std::thread &worker : workers_)
+            worker.join();
+    }
+
+    size_t size() const{
+        return workers_.size();
+    }
+
+    void submit(std::function<void()> task){
+        const size_t queue = current_pool_ == this ? current_index_
+                                                   : next_queue_.fetch_add(1) % queues_.size();
+        // Counted first, so the count never falls below the tasks really queued
+        {
+            std::lock_guard<std::mutex> lock(sleep_lock_);
+            ++queued_;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues_[queue]->lock);
+            queues_[queue]->tasks.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    // Run one queued task on the calling thread: a worker's own newest task
+    // first, otherwise the oldest task of any queue.
+    // Return false if every queue was empty.
+    bool runPendingTask(){
+        std::function<void()> task;
+        if(!TakeTask(task))
+            return false;
+        task();
+        return true;
+    }
+
+  private:
+    struct alignas(64) WorkQueue{
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Move a task into task, as runPendingTask() describes.
+    // Return false if every queue was empty.
+    bool TakeTask(std::function<void()> &task){
+        const size_t queues = queues_.size();
+        const bool is_worker = current_pool_ == this;
+        const size_t first = is_worker ? current_index_ : next_queue_.load() % queues;
+        if(is_worker){
+            WorkQueue &own = *queues_[first];
+            std::lock_guard<std::mutex> lock(own.lock);
+            if(!own.tasks.empty()){
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                Taken();
+                return true;
+            }
+        }
+        for(size_t k = is_worker ? 1 : 0; k < queues; ++k){
+            WorkQueue &victim = *queues_[(first + k) % queues];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if(!victim.tasks.empty()){
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                Taken();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Taken(){
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+        --queued_;
+    }
+
+    void WorkerLoop(size_t index){
+        current_pool_ = this;
+        current_index_ = index;
+        std::function<void()> task;
+        while(true){
+            if(TakeTask(task)){
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_lock_);
+            wake_.wait(lock, [this](){ return stop_ || queued_ > 0; });
+            if(stop_ && queued_ == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{0};
+    std::mutex sleep_lock_;            // Guards queued_ and stop_
+    std::condition_variable wake_;
+    size_t queued_ = 0;
+    bool stop_ = false;
+
+    // The pool and queue of the worker running on this thread, if any
+    inline static thread_local ThreadPool *current_pool_ = nullptr;
+    inline static thread_local size_t current_index_ = 0;
+};
+
+// TaskGroup class
+//
+// CONSTRUCTION: with the ThreadPool to run on
+//
+// ******************PUBLIC OPERATIONS*********************
+// void run( task )   --> Submit task as part of the group
+// void wait( )       --> Return once every task of the group has finished
+//
+// wait( ) runs queued tasks on the waiting thread while the group is busy, so a
+// task may itself start a group and wait on it without tying up a worker. If a
+// task throws, wait( ) rethrows the first exception once the group is done.
+
+class TaskGroup{
+  public:
+    explicit TaskGroup(ThreadPool &pool) : pool_(pool){ }
+
+    TaskGroup(const TaskGroup &rhs) = delete;
+    TaskGroup &operator=(const TaskGroup &rhs) = delete;
+
+    ~TaskGroup(){
+        Drain();
+    }
+
+    template <typename Task>
+    void run(Task task){
+        pending_.fetch_add(1);
+        pool_.submit([this, task](){
+            try{
+                task();
+            }
+            catch(...){
+                std::lock_guard<std::mutex> lock(error_lock_);
+                if(!error_)
+                    error_ = std::current_exception();
+            }
+            pending_.fetch_sub(1);
+        });
+    }
+
+    void wait(){
+        Drain();
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(error_lock_);
+            std::swap(error, error_);
+        }
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+  private:
+    void Drain(){
+        while(pending_.load() > 0)
+            if(!pool_.runPendingTask())
+                std::this_thread::yield();
+    }
+
+    ThreadPool &pool_;
+    std::atomic<size_t> pending_{0};
+    std::mutex error_lock_;
+    std::exception_ptr error_;
+};
+
+#endif
@@ -0,0 +1,301 @@
+// File's Title: tree_snapshot.h
+// Description: a versioned binary snapshot of an AvlTree<SequenceMap>, written once
+// after a build and then queried straight out of a read-only memory mapping.
+
+#ifndef TREE_SNAPSHOT_H
+#define TREE_SNAPSHOT_H
+
+#include "mapped_file.h"
+#include "sequence_map.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Snapshot file layout, in native (little-endian) byte order:
+//
+//   SnapshotHeader                         40 bytes
+//   SnapshotNode   nodes[ node_count ]     pre-order, children by index
+//   uint32_t       enzymes[ enzyme_count ] string ids of every node's acronyms
+//   uint32_t       offsets[ string_count + 1 ]
+//   char           strings[ string_bytes ] interned sequences and acronyms
+//
+// Every recognition sequence and acronym is stored once in the string table;
+// string i spans strings[ offsets[ i ], offsets[ i + 1 ] ). The nodes form a
+// height-balanced search tree over the sorted items. The checksum is FNV-1a
+// over everything after the header.
+
+const char SNAPSHOT_MAGIC[ 8 ] = { 'A', 'V', 'L', 'S', 'N', 'A', 'P', '\0' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_NONE = 0xFFFFFFFF;
+
+struct SnapshotHeader
+{
+    char     magic[ 8 ];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t enzyme_count;
+    uint32_t string_count;
+    uint64_t string_bytes;
+    uint64_t checksum;
+};
+
+struct SnapshotNode
+{
+    uint32_t sequence;       // String id of the recognition sequence
+    uint32_t left;           // Node index, or SNAPSHOT_NONE
+    uint32_t right;          // Node index, or SNAPSHOT_NONE
+    uint32_t first_enzyme;   // Index into the enzymes array
+    uint32_t enzyme_count;
+};
+
+// FNV-1a 64 of [data, data + size), continuing from hash.
+inline uint64_t SnapshotChecksum(const char *data, size_t size, uint64_t hash = 14695981039346656037ULL){
+    for(size_t i = 0; i < size; ++i){
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// @filename: any file.
+// Return true if the file starts with the snapshot magic.
+inline bool IsTreeSnapshot(const std::string &filename){
+    std::ifstream in_file(filename, std::ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    return in_file.read(magic, sizeof(magic)) && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+// @a_tree: a tree of SequenceMap.
+// @filename: the snapshot to write.
+// Return true if the snapshot was written.
+template <typename TreeType>
+bool WriteTreeSnapshot(const TreeType &a_tree, const std::string &filename){
+    std::vector<const SequenceMap *> items;
+    a_tree.forEach([&items](const SequenceMap &x){ items.push_back(&x); });
+
+    std::unordered_map<std::string_view, uint32_t> string_ids;
+    std::vector<uint32_t> offsets(1, 0);
+    std::string strings;
+    auto intern = [&](std::string_view x){
+        auto found = string_ids.find(x);
+        if(found != string_ids.end())
+            return found->second;
+        uint32_t id = static_cast<uint32_t>(offsets.size() - 1);
+        string_ids.emplace(x, id);
+        strings.append(x.data(), x.size());
+        offsets.push_back(static_cast<uint32_t>(strings.size()));
+        return id;
+    };
+
+    // Lay the sorted items out as a balanced tree in pre-order, so the root
+    // is node 0. Pending ranges point at child fields inside nodes, which the
+    // reserve() keeps from moving.
+    std::vector<SnapshotNode> nodes;
+    std::vector<uint32_t> enzymes;
+    nodes.reserve(items.size());
+    struct Range{
+        size_t low, high;
+        uint32_t *link;   // Where to store the index of the subtree's root
+    };
+    uint32_t root = SNAPSHOT_NONE;
+    std::vector<Range> pending;
+    if(!items.empty())
+        pending.push_back(Range{0, items.size(), &root});
+    while(!pending.empty()){
+        Range range = pending.back();
+        pending.pop_back();
+        size_t middle = range.low + (range.high - range.low) / 2;
+        const SequenceMap &x = *items[middle];
+        *range.link = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(SnapshotNode{intern(x.getRecognitionSequence()), SNAPSHOT_NONE, SNAPSHOT_NONE,
+                                     static_cast<uint32_t>(enzymes.size()), static_cast<uint32_t>(x.getEnzymeCount())});
+        for(size_t i = 0; i < x.getEnzymeCount(); ++i)
+            enzymes.push_back(intern(x.getEnzymeAcronym(i)));
+        SnapshotNode &node = nodes.back();
+        // Right goes on the stack first so the left subtree follows its root
+        if(middle + 1 < range.high)
+            pending.push_back(Range{middle + 1, range.high, &node.right});
+        if(range.low < middle)
+            pending.push_back(Range{range.low, middle, &node.left});
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.node_count = static_cast<uint32_t>(nodes.size());
+    header.enzyme_count = static_cast<uint32_t>(enzymes.size());
+    header.string_count = static_cast<uint32_t>(offsets.size() - 1);
+    header.string_bytes = strings.size();
+    uint64_t hash = SnapshotChecksum(reinterpret_cast<const char *>(nodes.data()), nodes.size() * sizeof(SnapshotNode));
+    hash = SnapshotChecksum(reinterpret_cast<const char *>(enzymes.data()), enzymes.size() * sizeof(uint32_t), hash);
+    hash = SnapshotChecksum(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t), hash);
+    header.checksum = SnapshotChecksum(strings.data(), strings.size(), hash);
+
+    std::ofstream out_file(filename, std::ios::binary | std::ios::trunc);
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_file.write(reinterpret_cast<const char *>(nodes.data()), nodes.size() * sizeof(SnapshotNode));
+    out_file.write(reinterpret_cast<const char *>(enzymes.data()), enzymes.size() * sizeof(uint32_t));
+    out_file.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    out_file.write(strings.data(), strings.size());
+    return static_cast<bool>(out_file);
+}
+
+// TreeSnapshot class
+//
+// CONSTRUCTION: with a snapshot filename; the file is mapped, not copied
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool isOpen( )         --> Return true if the snapshot mapped and checked out
+// bool contains( x )     --> Return true if recognition sequence x is present
+// void findRecoSeq( x )  --> Find x and print its enzyme acronym
+// int numberOfNodes()    --> Return number of nodes
+// int find( x, visited ) --> Return 1 if x is found, else 0; count nodes visited
+// void forEach( visit )  --> Call visit( sequence, acronyms ) in sorted order
+//
+// Loading checks the magic, the version, the section sizes, the checksum and
+// every index, then answers queries in place without allocating per node.
+
+class TreeSnapshot{
+  public:
+    explicit TreeSnapshot(const std::string &filename) : file_(filename), valid_(false){
+        valid_ = file_.isOpen() && Validate();
+    }
+
+    bool isOpen() const{
+        return valid_;
+    }
+
+    int numberOfNodes() const{
+        return valid_ ? header_->node_count : 0;
+    }
+
+    bool contains(std::string_view x) const{
+        int visited = 0;
+        return find(x, visited);
+    }
+
+    int find(std::string_view x, int &visited) const{
+        return Search(x, visited) != SNAPSHOT_NONE;
+    }
+
+    // Find x and print its enzyme acronyms like SequenceMap::printEnzymeAcronym()
+    // Else print "Not Found"
+    void findRecoSeq(std::string_view x) const{
+        int visited = 0;
+        uint32_t found = Search(x, visited);
+        if(found == SNAPSHOT_NONE){
+            std::cout<<"Not Found"<<std::endl;
+            return;
+        }
+        const SnapshotNode &node = nodes_[found];
+        for(uint32_t i = 0; i < node.enzyme_count; ++i)
+            std::cout<<String(enzymes_[node.first_enzyme + i])<<" ";
+        std::cout<<std::endl;
+    }
+
+    // @visit: called as visit(recognition_sequence, acronyms) for every node in
+    //  sorted order, where acronyms is a vector of views into the mapping.
+    template <typename Visitor>
+    void forEach(Visitor visit) const{
+        std::vector<uint32_t> path;
+        std::vector<std::string_view> acronyms;
+        uint32_t t = valid_ && header_->node_count > 0 ? 0 : SNAPSHOT_NONE;
+        while(t != SNAPSHOT_NONE || !path.empty()){
+            if(t != SNAPSHOT_NONE){
+                path.push_back(t);
+                t = nodes_[t].left;
+            }
+            else{
+                t = path.back();
+                path.pop_back();
+                const SnapshotNode &node = nodes_[t];
+                acronyms.clear();
+                for(uint32_t i = 0; i < node.enzyme_count; ++i)
+                    acronyms.push_back(String(enzymes_[node.first_enzyme + i]));
+                visit(String(node.sequence), acronyms);
+                t = node.right;
+            }
+        }
+    }
+
+  private:
+    MappedFile file_;
+    bool valid_;
+    const SnapshotHeader *header_ = nullptr;
+    const SnapshotNode *nodes_ = nullptr;
+    const uint32_t *enzymes_ = nullptr;
+    const uint32_t *offsets_ = nullptr;
+    const char *strings_ = nullptr;
+
+    std::string_view String(uint32_t id) const{
+        return std::string_view(strings_ + offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+
+    // Return the index of the node holding x, or SNAPSHOT_NONE
+    uint32_t Search(std::string_view x, int &visited) const{
+        uint32_t t = valid_ && header_->node_count > 0 ? 0 : SNAPSHOT_NONE;
+        while(true){
+            ++visited;
+            if(t == SNAPSHOT_NONE)
+                return t;
+            int order = x.compare(String(nodes_[t].sequence));
+            if(order < 0)
+                t = nodes_[t].left;
+            else if(order > 0)
+                t = nodes_[t].right;
+            else
+                return t;
+        }
+    }
+
+    bool Validate(){
+        std::string_view data = file_.contents();
+        if(data.size() < sizeof(SnapshotHeader))
+            return false;
+        header_ = reinterpret_cast<const SnapshotHeader *>(data.data());
+        if(std::memcmp(header_->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+           header_->version != SNAPSHOT_VERSION)
+            return false;
+
+        const uint64_t nodes_bytes = uint64_t(header_->node_count) * sizeof(SnapshotNode);
+        const uint64_t enzymes_bytes = uint64_t(header_->enzyme_count) * sizeof(uint32_t);
+        const uint64_t offsets_bytes = (uint64_t(header_->string_count) + 1) * sizeof(uint32_t);
+        if(data.size() != sizeof(SnapshotHeader) + nodes_bytes + enzymes_bytes + offsets_bytes + header_->string_bytes)
+            return false;
+        const char *body = data.data() + sizeof(SnapshotHeader);
+        if(SnapshotChecksum(body, data.size() - sizeof(SnapshotHeader)) != header_->checksum)
+            return false;
+
+        nodes_ = reinterpret_cast<const SnapshotNode *>(body);
+        enzymes_ = reinterpret_cast<const uint32_t *>(body + nodes_bytes);
+        offsets_ = reinterpret_cast<const uint32_t *>(body + nodes_bytes + enzymes_bytes);
+        strings_ = body + nodes_bytes + enzymes_bytes + offsets_bytes;
+
+        if(offsets_[0] != 0 || offsets_[header_->string_count] != header_->string_bytes)
+            return false;
+        for(uint32_t i = 0; i < header_->string_count; ++i)
+            if(offsets_[i] > offsets_[i + 1])
+                return false;
+        for(uint32_t i = 0; i < header_->enzyme_count; ++i)
+            if(enzymes_[i] >= header_->string_count)
+                return false;
+        // Pre-order puts every child after its parent, which also rules out cycles
+        for(uint32_t i = 0; i < header_->node_count; ++i){
+            const SnapshotNode &node = nodes_[i];
+            if(node.sequence >= header_->string_count ||
+               uint64_t(node.first_enzyme) + node.enzyme_count > header_->enzyme_count ||
+               (node.left != SNAPSHOT_NONE && (node.left <= i || node.left >= header_->node_count)) ||
+               (node.right != SNAPSHOT_NONE && (node.right <= i || node.right >= header_->node_count)))
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
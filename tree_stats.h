@@ -0,0 +1,153 @@
+// File's Title: tree_stats.h
+// Description: instrumentation policies for AvlTree. NoStats counts nothing and compiles
+// away; CountingStats counts what each kind of operation costs the tree.
+
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+// The kinds of operation AvlTree reports to its Stats policy.
+enum TreeOperation
+{
+    TREE_INSERT,          // insert( )
+    TREE_REMOVE,          // Both remove( )s
+    TREE_FIND,            // find( ), findBatch( ), contains( ), findRecoSeq( ), rank( ),
+                          // countRange( ), lower_bound( ), upper_bound( )
+    TREE_BUILD,           // bulkLoad( ), buildFromSorted( ), copies
+    TREE_SET_OPERATION,   // split( ), join( ), unionWith( ), intersect( ), difference( )
+    TREE_OPERATIONS
+};
+
+// What an operation costs. The rotations are named as in AvlTree: a single
+// rotation with the left child fixes a left-left imbalance (a right rotation),
+// a double rotation with the left child a left-right one, and so on.
+enum TreeEvent
+{
+    TREE_VISIT,                     // A node a search compared the key with
+    TREE_ELEMENT_COMPARISON,        // An element compare( ) had to read, the prefixes tied
+    TREE_ROTATE_WITH_LEFT_CHILD,    // Case 1, left-left
+    TREE_ROTATE_WITH_RIGHT_CHILD,   // Case 4, right-right
+    TREE_DOUBLE_WITH_LEFT_CHILD,    // Case 2, left-right
+    TREE_DOUBLE_WITH_RIGHT_CHILD,   // Case 3, right-left
+    TREE_ALLOCATION,                // A node built
+    TREE_REBALANCE,                 // A node's balance checked and its fields updated
+    TREE_EVENTS
+};
+
+// NoStats class
+//
+// The default Stats policy of AvlTree. Every hook is empty and inline, so
+// an uninstrumented tree carries no trace of them.
+
+struct NoStats
+{
+    void begin( TreeOperation op ) const
+    { }
+
+    void record( TreeEvent event ) const
+    { }
+
+    void reset( )
+    { }
+};
+
+// CountingStats class
+//
+// CONSTRUCTION: zero parameter
+//
+// ******************PUBLIC OPERATIONS*********************
+// void begin( op )          --> Start an operation of kind op (called by AvlTree)
+// void record( event )      --> Count event against it (called by AvlTree)
+// size_t operations( op )   --> Return the number of operations of kind op
+// size_t events( op, e )    --> Return the number of events e during them
+// size_t total( e )         --> Return the number of events e in all
+// void reset( )             --> Set every count to zero
+// void print( out )         --> Print the counts per operation to out
+//
+// Events count against the kind of the operation begun last. The counts are
+// relaxed atomics, so concurrent readers of a const tree and the tasks of a
+// parallel set operation may record at once; only the attribution of events
+// to operations is blurred when different kinds overlap.
+
+class CountingStats
+{
+  public:
+    CountingStats( )
+    {
+        reset( );
+    }
+
+    void begin( TreeOperation op ) const
+    {
+        current.store( op, std::memory_order_relaxed );
+        counts[ op ][ TREE_EVENTS ].fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void record( TreeEvent event ) const
+    {
+        counts[ current.load( std::memory_order_relaxed ) ][ event ].fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    size_t operations( TreeOperation op ) const
+    {
+        return counts[ op ][ TREE_EVENTS ].load( std::memory_order_relaxed );
+    }
+
+    size_t events( TreeOperation op, TreeEvent event ) const
+    {
+        return counts[ op ][ event ].load( std::memory_order_relaxed );
+    }
+
+    size_t total( TreeEvent event ) const
+    {
+        size_t sum = 0;
+        for( int op = 0; op < TREE_OPERATIONS; ++op )
+            sum += events( TreeOperation( op ), event );
+        return sum;
+    }
+
+    void reset( )
+    {
+        current.store( TREE_BUILD, std::memory_order_relaxed );
+        for( int op = 0; op < TREE_OPERATIONS; ++op )
+            for( int event = 0; event <= TREE_EVENTS; ++event )
+                counts[ op ][ event ].store( 0, std::memory_order_relaxed );
+    }
+
+    /**
+     * Print one line per kind of operation that ran: how many ran, and the
+     * events per operation.
+     */
+    void print( std::ostream & out ) const
+    {
+        static const char *OPERATION_NAMES[ TREE_OPERATIONS ] = { "insert", "remove", "find", "build", "set" };
+        out << std::left << std::setw( 8 ) << "op" << std::right << std::setw( 10 ) << "count"
+            << std::setw( 9 ) << "visits" << std::setw( 9 ) << "elemcmp"
+            << std::setw( 8 ) << "LL" << std::setw( 8 ) << "RR" << std::setw( 8 ) << "LR" << std::setw( 8 ) << "RL"
+            << std::setw( 9 ) << "allocs" << std::setw( 9 ) << "rebal" << std::endl;
+        for( int op = 0; op < TREE_OPERATIONS; ++op )
+        {
+            const size_t n = operations( TreeOperation( op ) );
+            if( n == 0 )
+                continue;
+            out << std::left << std::setw( 8 ) << OPERATION_NAMES[ op ] << std::right << std::setw( 10 ) << n
+                << std::fixed << std::setprecision( 2 );
+            for( int event = 0; event < TREE_EVENTS; ++event )
+                out << std::setw( event >= TREE_ROTATE_WITH_LEFT_CHILD && event <= TREE_DOUBLE_WITH_RIGHT_CHILD ? 8 : 9 )
+                    << double( events( TreeOperation( op ), TreeEvent( event ) ) ) / n;
+            out << std::endl;
+            out.unsetf( std::ios::floatfield );
+        }
+    }
+
+  private:
+    // counts[ op ][ TREE_EVENTS ] counts the operations themselves
+    mutable std::atomic<size_t> counts[ TREE_OPERATIONS ][ TREE_EVENTS + 1 ];
+    mutable std::atomic<int> current;
+};
+
+#endif